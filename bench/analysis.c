@@ -0,0 +1,210 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "schedulable.h"
+#include "vibeomatic.h"
+
+/*
+ * Compares the cost and the scores of the vibe-o-matic at the full sample
+ * frequency with those of decimated analysis rates.
+ *
+ * The synthetic vibe consists of beat-modulated tones and noise bursts below
+ * 4 kHz, which is the range the scoring is sensitive to.
+ */
+
+#define SAMPLE_FREQUENCY 48000
+#define CHANNELS 2
+#define SECONDS 30
+
+static short *_synthesize(unsigned long frame_count);
+static double _elapsed(const struct timespec *start);
+
+int main(void) {
+    static const unsigned long decimations[] = { 1, 2, 3, 4, 6 };
+    struct vibexec_schedulable_parameters parameters;
+    struct vibexec_vibeomatic_session reference;
+    unsigned long frame_count, i;
+    double reference_time;
+    short *vibe;
+
+    parameters.channels = CHANNELS;
+    parameters.sample_frequency = SAMPLE_FREQUENCY;
+    parameters.sample_format = SIGNED_16BIT;
+
+    frame_count = (unsigned long) SAMPLE_FREQUENCY * SECONDS;
+    vibe = _synthesize(frame_count);
+
+    if (!vibe) {
+        fputs("Cannot allocate memory.\n", stderr);
+        return 1;
+    }
+
+    printf(
+        "%-10s %-12s %-12s %-8s %-12s %s\n",
+        "rate", "window", "seconds", "speedup", "mean diff", "max diff"
+    );
+
+    for (i = 0; i < sizeof(decimations) / sizeof(decimations[0]); i++) {
+        struct vibexec_vibeomatic_session session, *target;
+        struct timespec start;
+        unsigned long frame, window, score, score_count;
+        double elapsed, mean_difference, max_difference;
+
+        target = i ? &session : &reference;
+        window = (SAMPLE_FREQUENCY / decimations[i]) >> 6;
+
+        if (
+            vibexec_vibeomatic_initialize(
+                target,
+                &parameters,
+                window,
+                decimations[i]
+            )
+        ) {
+            return 1;
+        }
+
+        /* Feed one second at a time, like the scheduler does. */
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (frame = 0; frame < frame_count; frame += SAMPLE_FREQUENCY) {
+            vibexec_vibeomatic_analyze(
+                target,
+                vibe + frame * CHANNELS,
+                SAMPLE_FREQUENCY * CHANNELS * sizeof(short)
+            );
+        }
+
+        elapsed = _elapsed(&start);
+
+        if (!i) {
+            reference_time = elapsed;
+        }
+
+        /*
+         * Compare the score timeline with the full-rate one by time, since
+         * the windows of both need not span the same number of frames. Each
+         * window is compared with the full-rate window at its center.
+         */
+
+        score_count = 0;
+        mean_difference = 0.0;
+        max_difference = 0.0;
+
+        for (score = 0; score < target->cache.score_buffer_limit; score++) {
+            unsigned long reference_score;
+            double difference;
+
+            reference_score = (unsigned long) (
+                (score + 0.5)
+                * target->cache.nanoseconds_per_window
+                / reference.cache.nanoseconds_per_window
+            );
+
+            if (reference_score >= reference.cache.score_buffer_limit) {
+                break;
+            }
+
+            difference = fabs(
+                target->cache.score_buffer[score]
+                - reference.cache.score_buffer[reference_score]
+            );
+
+            score_count++;
+
+            mean_difference += difference;
+
+            if (difference > max_difference) {
+                max_difference = difference;
+            }
+        }
+
+        if (score_count) {
+            mean_difference /= score_count;
+        }
+
+        printf(
+            "%-10lu %-12lu %-12.4f %-8.2f %-12.4f %.4f\n",
+            SAMPLE_FREQUENCY / decimations[i],
+            window,
+            elapsed,
+            reference_time / elapsed,
+            mean_difference,
+            max_difference
+        );
+
+        if (i) {
+            vibexec_vibeomatic_cleanup(&session);
+        }
+    }
+
+    vibexec_vibeomatic_cleanup(&reference);
+    free(vibe);
+
+    return 0;
+}
+
+static short *_synthesize(unsigned long frame_count) {
+    static const double tones[] = { 110.0, 220.0, 440.0, 660.0, 1320.0 };
+    unsigned long frame, noise;
+    double filtered[3] = { 0.0, 0.0, 0.0 };
+    short *vibe;
+
+    vibe = malloc(sizeof(short) * CHANNELS * frame_count);
+
+    if (!vibe) {
+        return NULL;
+    }
+
+    noise = 1;
+
+    for (frame = 0; frame < frame_count; frame++) {
+        double time, beat, amplitude, burst;
+        unsigned int tone, channel, stage;
+
+        time = (double) frame / SAMPLE_FREQUENCY;
+        beat = fmod(time, 0.5);
+
+        /* Tones that swell with a slow envelope. */
+
+        amplitude = 0.0;
+
+        for (tone = 0; tone < sizeof(tones) / sizeof(tones[0]); tone++) {
+            amplitude +=
+                0.08
+                * (1.0 + sin(2.0 * M_PI * (tone + 1) * time / SECONDS))
+                * sin(2.0 * M_PI * tones[tone] * time);
+        }
+
+        /* Decaying bursts of low-passed noise on every beat. */
+
+        noise = noise * 1103515245 + 12345;
+        burst = ((double) ((noise >> 16) & 0x7FFF) / 16384.0 - 1.0);
+
+        for (stage = 0; stage < 3; stage++) {
+            filtered[stage] += 0.15 * (burst - filtered[stage]);
+            burst = filtered[stage];
+        }
+
+        amplitude += 2.0 * exp(-beat * 20.0) * burst;
+
+        for (channel = 0; channel < CHANNELS; channel++) {
+            vibe[frame * CHANNELS + channel] = (short) (amplitude * 16000.0);
+        }
+    }
+
+    return vibe;
+}
+
+static double _elapsed(const struct timespec *start) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return
+        (end.tv_sec - start->tv_sec)
+        + (end.tv_nsec - start->tv_nsec) / 1000000000.0;
+}
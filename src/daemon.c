@@ -0,0 +1,622 @@
+/* accept4 is a GNU extension. */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "daemon.h"
+#include "governor.h"
+#include "player.h"
+#include "scheduler.h"
+#include "tracee.h"
+
+/* Maximum size of a program submission, including all arguments. */
+#define CONTROL_MESSAGE_SIZE 65536
+
+#define MAX_EVENTS 32
+
+enum _endpoint_kind {
+    ENDPOINT_SIGNALS,
+    ENDPOINT_LISTENER,
+    ENDPOINT_CLIENT,
+    ENDPOINT_PLAYER,
+    ENDPOINT_SESSION
+};
+
+struct _endpoint {
+    enum _endpoint_kind kind;
+    int descriptor;
+};
+
+struct _session {
+    /* Timer that ends the current pause, must be the first member. */
+
+    struct _endpoint timer;
+
+    struct vibexec_tracee tracee;
+    int terminated;
+    struct _session *next;
+};
+
+static struct {
+    struct vibexec_scheduler *scheduler;
+    double slowdown_budget;
+    int epoll;
+    int running;
+
+    struct _endpoint signals, listener, player;
+    struct _session *sessions;
+} _daemon;
+
+static void _handle_client(struct _endpoint *client);
+static void _handle_listener(void);
+static void _handle_player(void);
+static void _handle_session(struct _session *session);
+static void _handle_signals(void);
+static void _handle_stop(void *context, pid_t pid, int status);
+static struct _session *_launch(char *const program[]);
+static void _sweep_sessions(void);
+static int _watch(struct _endpoint *endpoint);
+
+int vibexec_daemon_run(
+    struct vibexec_scheduler *scheduler,
+    const char *socket_path,
+    char *const program[],
+    double slowdown_budget
+) {
+    struct epoll_event events[MAX_EVENTS];
+    struct itimerspec player_interval;
+    sigset_t signals, previous_signals;
+
+    _daemon.scheduler = scheduler;
+    _daemon.slowdown_budget = slowdown_budget;
+    _daemon.sessions = NULL;
+    _daemon.running = 1;
+    _daemon.signals.descriptor = -1;
+    _daemon.player.descriptor = -1;
+    _daemon.listener.descriptor = -1;
+
+    _daemon.epoll = epoll_create1(EPOLL_CLOEXEC);
+
+    if (_daemon.epoll == -1) {
+        fputs("Cannot create event loop.\n", stderr);
+        goto error_return;
+    }
+
+    /* Receive child notifications and termination requests as events. */
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, &previous_signals);
+
+    _daemon.signals.kind = ENDPOINT_SIGNALS;
+    _daemon.signals.descriptor = signalfd(
+        -1,
+        &signals,
+        SFD_CLOEXEC | SFD_NONBLOCK
+    );
+
+    if (_daemon.signals.descriptor == -1 || _watch(&_daemon.signals)) {
+        fputs("Cannot watch signals.\n", stderr);
+        goto error_cleanup_signals;
+    }
+
+    /* Keep the playback going, even if no program stops. */
+
+    _daemon.player.kind = ENDPOINT_PLAYER;
+    _daemon.player.descriptor = timerfd_create(
+        CLOCK_MONOTONIC,
+        TFD_CLOEXEC | TFD_NONBLOCK
+    );
+
+    if (_daemon.player.descriptor == -1 || _watch(&_daemon.player)) {
+        fputs("Cannot create playback timer.\n", stderr);
+        goto error_cleanup_player;
+    }
+
+    player_interval.it_value.tv_sec = 0;
+    player_interval.it_value.tv_nsec = VIBEXEC_PLAYER_INTERVAL_NANOSECONDS;
+    player_interval.it_interval = player_interval.it_value;
+    timerfd_settime(_daemon.player.descriptor, 0, &player_interval, NULL);
+
+    /* Open the control socket. */
+
+    if (socket_path) {
+        struct sockaddr_un address;
+        struct stat socket_stat;
+
+        if (strlen(socket_path) >= sizeof(address.sun_path)) {
+            fputs("Control socket path too long.\n", stderr);
+            goto error_cleanup_player;
+        }
+
+        memset(&address, 0, sizeof(struct sockaddr_un));
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, socket_path);
+
+        /* Replace stale sockets of previous runs, but nothing else. */
+
+        if (
+            !stat(socket_path, &socket_stat) &&
+            S_ISSOCK(socket_stat.st_mode)
+        ) {
+            unlink(socket_path);
+        }
+
+        _daemon.listener.kind = ENDPOINT_LISTENER;
+        _daemon.listener.descriptor = socket(
+            AF_UNIX,
+            SOCK_SEQPACKET | SOCK_CLOEXEC,
+            0
+        );
+
+        if (
+            _daemon.listener.descriptor == -1 ||
+            bind(
+                _daemon.listener.descriptor,
+                (struct sockaddr *) &address,
+                sizeof(struct sockaddr_un)
+            ) ||
+            listen(_daemon.listener.descriptor, 16) ||
+            _watch(&_daemon.listener)
+        ) {
+            fputs("Cannot open control socket.\n", stderr);
+            goto error_cleanup_listener;
+        }
+    }
+
+    /* Launch the initial program. */
+
+    if (program && !_launch(program)) {
+        goto error_cleanup_listener;
+    }
+
+    /* Loop until terminated. */
+
+    while (
+        _daemon.running &&
+        (_daemon.listener.descriptor != -1 || _daemon.sessions)
+    ) {
+        int event_count, i;
+
+        event_count = epoll_wait(_daemon.epoll, events, MAX_EVENTS, -1);
+
+        if (event_count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            fputs("Waiting for events failed.\n", stderr);
+            break;
+        }
+
+        for (i = 0; i < event_count; i++) {
+            struct _endpoint *endpoint = events[i].data.ptr;
+
+            switch (endpoint->kind) {
+                case ENDPOINT_SIGNALS:
+                    _handle_signals();
+                    break;
+
+                case ENDPOINT_LISTENER:
+                    _handle_listener();
+                    break;
+
+                case ENDPOINT_CLIENT:
+                    _handle_client(endpoint);
+                    break;
+
+                case ENDPOINT_PLAYER:
+                    _handle_player();
+                    break;
+
+                case ENDPOINT_SESSION:
+                    _handle_session((struct _session *) endpoint);
+                    break;
+            }
+        }
+
+        /*
+         * Sessions are released only after all events of the batch have been
+         * handled, since later events may still refer to them.
+         */
+
+        _sweep_sessions();
+    }
+
+    /* Finalize. */
+
+    while (_daemon.sessions) {
+        _daemon.sessions->terminated = 1;
+        _sweep_sessions();
+    }
+
+    if (_daemon.listener.descriptor != -1) {
+        close(_daemon.listener.descriptor);
+        unlink(socket_path);
+    }
+
+    close(_daemon.player.descriptor);
+    close(_daemon.signals.descriptor);
+    sigprocmask(SIG_SETMASK, &previous_signals, NULL);
+    close(_daemon.epoll);
+    return 0;
+
+error_cleanup_listener:
+    if (_daemon.listener.descriptor != -1) {
+        close(_daemon.listener.descriptor);
+    }
+error_cleanup_player:
+    if (_daemon.player.descriptor != -1) {
+        close(_daemon.player.descriptor);
+    }
+error_cleanup_signals:
+    if (_daemon.signals.descriptor != -1) {
+        close(_daemon.signals.descriptor);
+    }
+
+    sigprocmask(SIG_SETMASK, &previous_signals, NULL);
+    close(_daemon.epoll);
+error_return:
+    return -1;
+}
+
+long vibexec_daemon_submit(const char *socket_path, char *const program[]) {
+    struct sockaddr_un address;
+    char *message, reply[32];
+    size_t message_size;
+    ssize_t reply_size;
+    int connection, i;
+    long pid;
+
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fputs("Control socket path too long.\n", stderr);
+        goto error_return;
+    }
+
+    memset(&address, 0, sizeof(struct sockaddr_un));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+
+    /* Serialize the program as sequence of NUL-terminated arguments. */
+
+    for (message_size = 0, i = 0; program[i]; i++) {
+        message_size += strlen(program[i]) + 1;
+    }
+
+    if (message_size > CONTROL_MESSAGE_SIZE) {
+        fputs("Program arguments too long.\n", stderr);
+        goto error_return;
+    }
+
+    message = malloc(message_size);
+
+    if (!message) {
+        fputs("Cannot allocate memory.\n", stderr);
+        goto error_return;
+    }
+
+    for (message_size = 0, i = 0; program[i]; i++) {
+        strcpy(message + message_size, program[i]);
+        message_size += strlen(program[i]) + 1;
+    }
+
+    /* Submit and wait for the reply. */
+
+    connection = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+    if (
+        connection == -1 ||
+        connect(
+            connection,
+            (struct sockaddr *) &address,
+            sizeof(struct sockaddr_un)
+        )
+    ) {
+        fputs("Cannot connect to daemon.\n", stderr);
+        goto error_cleanup_connection;
+    }
+
+    if (send(connection, message, message_size, 0) == -1) {
+        fputs("Cannot submit program.\n", stderr);
+        goto error_cleanup_connection;
+    }
+
+    reply_size = recv(connection, reply, sizeof(reply) - 1, 0);
+
+    if (reply_size <= 0) {
+        fputs("Daemon did not reply.\n", stderr);
+        goto error_cleanup_connection;
+    }
+
+    reply[reply_size] = '\0';
+    pid = strtol(reply, NULL, 10);
+
+    close(connection);
+    free(message);
+    return pid;
+
+error_cleanup_connection:
+    if (connection != -1) {
+        close(connection);
+    }
+
+    free(message);
+error_return:
+    return -1;
+}
+
+static void _handle_client(struct _endpoint *client) {
+    char *message, **program, reply[32];
+    ssize_t message_size;
+    struct _session *session;
+    long i, argument_count;
+
+    message = malloc(CONTROL_MESSAGE_SIZE + 1);
+
+    if (!message) {
+        fputs("Cannot allocate memory.\n", stderr);
+        goto cleanup_client;
+    }
+
+    message_size = recv(client->descriptor, message, CONTROL_MESSAGE_SIZE, 0);
+
+    if (message_size <= 0) {
+        goto cleanup_message;
+    }
+
+    if (message[message_size - 1] != '\0') {
+        message[message_size++] = '\0';
+    }
+
+    /* Split the message into arguments. */
+
+    for (argument_count = 0, i = 0; i < message_size; i++) {
+        if (message[i] == '\0') {
+            argument_count++;
+        }
+    }
+
+    program = malloc(sizeof(char *) * (argument_count + 1));
+
+    if (!program) {
+        fputs("Cannot allocate memory.\n", stderr);
+        goto cleanup_message;
+    }
+
+    program[0] = message;
+
+    for (argument_count = 1, i = 0; i < message_size - 1; i++) {
+        if (message[i] == '\0') {
+            program[argument_count++] = message + i + 1;
+        }
+    }
+
+    program[argument_count] = NULL;
+
+    /* Launch and reply the process id. */
+
+    session = _launch(program);
+
+    snprintf(
+        reply, sizeof(reply),
+        "%ld\n",
+        session ? (long) session->tracee.pid : -1L
+    );
+
+    send(client->descriptor, reply, strlen(reply), MSG_NOSIGNAL);
+    free(program);
+
+cleanup_message:
+    free(message);
+cleanup_client:
+    close(client->descriptor);
+    free(client);
+}
+
+static void _handle_listener(void) {
+    struct _endpoint *client;
+
+    client = malloc(sizeof(struct _endpoint));
+
+    if (!client) {
+        fputs("Cannot allocate memory.\n", stderr);
+        return;
+    }
+
+    client->kind = ENDPOINT_CLIENT;
+    client->descriptor = accept4(
+        _daemon.listener.descriptor,
+        NULL, NULL,
+        SOCK_CLOEXEC
+    );
+
+    if (client->descriptor == -1 || _watch(client)) {
+        fputs("Cannot accept client.\n", stderr);
+
+        if (client->descriptor != -1) {
+            close(client->descriptor);
+        }
+
+        free(client);
+    }
+}
+
+static void _handle_player(void) {
+    uint64_t expirations;
+
+    if (read(_daemon.player.descriptor, &expirations, sizeof(uint64_t)) > 0) {
+        vibexec_player_update(&_daemon.scheduler->player);
+    }
+}
+
+static void _handle_session(struct _session *session) {
+    uint64_t expirations;
+
+    if (read(session->timer.descriptor, &expirations, sizeof(uint64_t)) <= 0) {
+        return;
+    }
+
+    /* The pause is over. */
+
+    if (!session->terminated) {
+        vibexec_tracee_resume(&session->tracee);
+    }
+}
+
+static void _handle_signals(void) {
+    struct signalfd_siginfo info;
+
+    while (
+        read(
+            _daemon.signals.descriptor,
+            &info,
+            sizeof(struct signalfd_siginfo)
+        ) == sizeof(struct signalfd_siginfo)
+    ) {
+        if (info.ssi_signo == SIGINT || info.ssi_signo == SIGTERM) {
+            _daemon.running = 0;
+        }
+    }
+
+    vibexec_tracee_collect_stops(_handle_stop, NULL);
+}
+
+static void _handle_stop(void *context, pid_t pid, int status) {
+    struct _session *session;
+    struct timespec pause;
+    struct itimerspec timer;
+
+    for (
+        session = _daemon.sessions;
+        session && session->tracee.pid != pid;
+        session = session->next
+    );
+
+    if (!session || session->terminated) {
+        return;
+    }
+
+    if (vibexec_tracee_handle_status(&session->tracee, status)) {
+        session->terminated = 1;
+        return;
+    }
+
+    /* Events, like the one after execve, are no system calls. */
+
+    if (status >> 16) {
+        vibexec_tracee_resume(&session->tracee);
+        return;
+    }
+
+    /* Pause the program by delaying its resumption. */
+
+    vibexec_tracee_pause(&session->tracee, _daemon.scheduler, &pause);
+
+    if (!pause.tv_sec && !pause.tv_nsec) {
+        vibexec_tracee_resume(&session->tracee);
+        return;
+    }
+
+    memset(&timer, 0, sizeof(struct itimerspec));
+    timer.it_value = pause;
+    timerfd_settime(session->timer.descriptor, 0, &timer, NULL);
+}
+
+static struct _session *_launch(char *const program[]) {
+    struct _session *session;
+
+    session = malloc(sizeof(struct _session));
+
+    if (!session) {
+        fputs("Cannot allocate memory.\n", stderr);
+        goto error_return;
+    }
+
+    session->terminated = 0;
+    session->timer.kind = ENDPOINT_SESSION;
+    session->timer.descriptor = timerfd_create(
+        CLOCK_MONOTONIC,
+        TFD_CLOEXEC | TFD_NONBLOCK
+    );
+
+    if (session->timer.descriptor == -1 || _watch(&session->timer)) {
+        fputs("Cannot create session timer.\n", stderr);
+        goto error_cleanup_timer;
+    }
+
+    vibexec_governor_initialize(
+        &session->tracee.governor,
+        _daemon.slowdown_budget
+    );
+
+    if (vibexec_tracee_spawn(&session->tracee, program)) {
+        goto error_cleanup_timer;
+    }
+
+    if (vibexec_tracee_resume(&session->tracee)) {
+        goto error_cleanup_timer;
+    }
+
+    session->next = _daemon.sessions;
+    _daemon.sessions = session;
+
+    return session;
+
+error_cleanup_timer:
+    if (session->timer.descriptor != -1) {
+        close(session->timer.descriptor);
+    }
+
+    free(session);
+error_return:
+    return NULL;
+}
+
+static void _sweep_sessions(void) {
+    struct _session **link;
+
+    for (link = &_daemon.sessions; *link;) {
+        struct _session *session = *link;
+
+        if (!session->terminated) {
+            link = &session->next;
+            continue;
+        }
+
+        *link = session->next;
+        close(session->timer.descriptor);
+        free(session);
+    }
+}
+
+static int _watch(struct _endpoint *endpoint) {
+    struct epoll_event event;
+
+    event.events = EPOLLIN;
+    event.data.ptr = endpoint;
+
+    return epoll_ctl(
+        _daemon.epoll,
+        EPOLL_CTL_ADD,
+        endpoint->descriptor,
+        &event
+    );
+}
@@ -0,0 +1,30 @@
+#ifndef _VIBEXEC_DAEMON_H_
+#define _VIBEXEC_DAEMON_H_
+
+#include "scheduler.h"
+
+/*
+ * Traces any number of programs concurrently, all of which share the vibe of
+ * the scheduler.
+ *
+ * Programs are either passed initially (program may be NULL) or submitted at
+ * runtime through the control socket at socket_path (may be NULL). Without a
+ * control socket, the daemon returns once all programs terminated.
+ *
+ * Each program may be slowed down by at most slowdown_budget (see governor),
+ * a non-positive budget leaves the slowdown unbounded.
+ */
+int vibexec_daemon_run(
+    struct vibexec_scheduler *scheduler,
+    const char *socket_path,
+    char *const program[],
+    double slowdown_budget
+);
+
+/*
+ * Asks the daemon listening at socket_path to trace the program. Returns the
+ * process id of the launched program or -1.
+ */
+long vibexec_daemon_submit(const char *socket_path, char *const program[]);
+
+#endif
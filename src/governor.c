@@ -0,0 +1,167 @@
+#include <string.h>
+#include <time.h>
+
+#include "governor.h"
+#include "vibeomatic.h"
+
+/* Length of a control interval in nanoseconds. */
+#define INTERVAL_NANOSECONDS 100000000.0
+
+/* Share of the gap that is closed per interval, if the gain rises. */
+#define GAIN_RECOVERY 0.25
+
+static inline double _to_nanoseconds(const struct timespec *time);
+
+void vibexec_governor_initialize(
+    struct vibexec_governor *governor,
+    double budget
+) {
+    memset(governor, 0, sizeof(struct vibexec_governor));
+
+    governor->budget = budget;
+    governor->gain = 1.0;
+}
+
+void vibexec_governor_limit(
+    struct vibexec_governor *governor,
+    const struct timespec *stop_time,
+    struct timespec *pause
+) {
+    struct timespec difference;
+    double own_time, requested, granted, interval_length;
+
+    /* A non-positive budget disables the governor. */
+
+    if (governor->budget <= 0.0) {
+        return;
+    }
+
+    if (!governor->cache.started) {
+        governor->cache.interval_start = *stop_time;
+        governor->cache.started = 1;
+    }
+
+    /*
+     * Only the time from the last resumption to this stop was spent by the
+     * program on its own, which excludes both the pause and the work of the
+     * tracer meanwhile. It earns credit, which is capped to the budget of a
+     * single interval to prevent idle phases from accumulating large bursts.
+     */
+
+    own_time = 0.0;
+
+    if (governor->cache.resumed) {
+        _compute_difference(
+            &difference,
+            stop_time,
+            &governor->cache.last_resume
+        );
+
+        own_time = _to_nanoseconds(&difference);
+        governor->cache.resumed = 0;
+    }
+
+    if (own_time < 0.0) {
+        own_time = 0.0;
+    }
+
+    governor->cache.credit += governor->budget * own_time;
+
+    if (governor->cache.credit > governor->budget * INTERVAL_NANOSECONDS) {
+        governor->cache.credit = governor->budget * INTERVAL_NANOSECONDS;
+    }
+
+    requested = _to_nanoseconds(pause);
+
+    governor->cache.interval_requested += requested;
+    governor->cache.interval_own_time += own_time;
+
+    /* Adjust the gain at the end of each interval. */
+
+    _compute_difference(
+        &difference,
+        stop_time,
+        &governor->cache.interval_start
+    );
+
+    interval_length = _to_nanoseconds(&difference);
+
+    if (interval_length >= INTERVAL_NANOSECONDS) {
+        double target_gain = 1.0;
+
+        if (governor->cache.interval_requested > 0.0) {
+            target_gain =
+                governor->budget * governor->cache.interval_own_time
+                / governor->cache.interval_requested;
+        }
+
+        if (target_gain > 1.0) {
+            target_gain = 1.0;
+        }
+
+        /* Back off immediately, but recover slowly. */
+
+        if (target_gain < governor->gain) {
+            governor->gain = target_gain;
+        } else {
+            governor->gain += (target_gain - governor->gain) * GAIN_RECOVERY;
+        }
+
+        governor->cache.interval_start = *stop_time;
+        governor->cache.interval_requested = 0.0;
+        governor->cache.interval_own_time = 0.0;
+    }
+
+    /* Scale the pause, but never beyond the available credit. */
+
+    granted = requested * governor->gain;
+
+    if (granted > governor->cache.credit) {
+        granted = governor->cache.credit;
+    }
+
+    if (granted < 0.0) {
+        granted = 0.0;
+    }
+
+    governor->cache.credit -= granted;
+    governor->cache.last_stop = *stop_time;
+    governor->cache.last_pause = granted;
+    governor->cache.stopped = 1;
+
+    pause->tv_sec = (time_t) (granted / 1000000000.0);
+    pause->tv_nsec = (long) (granted - pause->tv_sec * 1000000000.0);
+}
+
+void vibexec_governor_resume(
+    struct vibexec_governor *governor,
+    const struct timespec *resume_time
+) {
+    struct timespec difference;
+    double overshoot;
+
+    governor->cache.last_resume = *resume_time;
+    governor->cache.resumed = 1;
+
+    if (!governor->cache.stopped) {
+        return;
+    }
+
+    /*
+     * The stop outlasts the granted pause by the work of the tracer and the
+     * slack of its timers, which slows the program down just the same.
+     */
+
+    _compute_difference(&difference, resume_time, &governor->cache.last_stop);
+    overshoot = _to_nanoseconds(&difference) - governor->cache.last_pause;
+
+    if (overshoot > 0.0) {
+        governor->cache.credit -= overshoot;
+    }
+
+    governor->cache.stopped = 0;
+}
+
+static inline double _to_nanoseconds(const struct timespec *time) {
+    return time->tv_sec * 1000000000.0 + time->tv_nsec;
+}
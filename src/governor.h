@@ -0,0 +1,62 @@
+#ifndef _VIBEXEC_GOVERNOR_H_
+#define _VIBEXEC_GOVERNOR_H_
+
+#include <time.h>
+
+/*
+ * Feedback controller that bounds the slowdown of a traced program.
+ *
+ * The budget is the maximum ratio between the injected pauses and the time
+ * the program runs on its own, e.g. 0.2 for at most 20% more wall time. Per
+ * interval, the governor compares the pauses requested by the vibe with the
+ * budget of the interval and scales the score-to-pause mapping accordingly.
+ * A credit account on top guarantees that no pause exceeds the budget
+ * earned so far. Stops that last longer than the granted pause, e.g. due to
+ * timer slack, are charged to the account as well.
+ */
+struct vibexec_governor {
+    double budget;
+    double gain;
+
+    struct {
+        int started;
+        int stopped;
+        int resumed;
+        struct timespec last_stop;
+        struct timespec last_resume;
+        double last_pause;
+        double credit;
+
+        /* Current interval. */
+
+        struct timespec interval_start;
+        double interval_requested;
+        double interval_own_time;
+    } cache;
+};
+
+void vibexec_governor_initialize(
+    struct vibexec_governor *governor,
+    double budget
+);
+
+/*
+ * Scales the pause of the current stop down to the budget, if necessary. The
+ * stop time refers to CLOCK_MONOTONIC.
+ */
+void vibexec_governor_limit(
+    struct vibexec_governor *governor,
+    const struct timespec *stop_time,
+    struct timespec *pause
+);
+
+/*
+ * Records that the program was resumed at the given time on CLOCK_MONOTONIC,
+ * which ends the current stop and starts the time it runs on its own.
+ */
+void vibexec_governor_resume(
+    struct vibexec_governor *governor,
+    const struct timespec *resume_time
+);
+
+#endif
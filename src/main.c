@@ -1,83 +1,191 @@
 #include <stdio.h>
-#include <signal.h>
+#include <stdlib.h>
 #include <unistd.h>
-#include <sys/ptrace.h>
 #include <sys/types.h>
-#include <sys/wait.h>
 
-#include "player.h"
+#include "daemon.h"
+#include "process.h"
 #include "scheduler.h"
 
+static struct vibexec_scheduler _scheduler;
+
 int main(int argc, char *argv[]) {
     struct vibexec_schedulable_vibe vibe;
-    pid_t child_pid;
-    int child_status;
-
-    if (argc < 2) {
-        fputs("No program provided.\n", stderr);
-        return 1;
-    }
+    struct vibexec_process process;
+    const char *client_socket, *daemon_socket;
+    int daemonize, option, status;
+    double slowdown_budget, quiet_threshold;
+    char **program;
+    pid_t attach_pid;
 
     vibe.parameters.channels = 2;
     vibe.parameters.sample_format = SIGNED_16BIT;
     vibe.parameters.sample_frequency = 48000;
     vibe.path = "sample.pcm";
+    vibe.analysis_workers = 0;
+    vibe.analysis_frequency = 0;
+    vibe.readahead = 4;
+    vibe.timeline_name = NULL;
+    vibe.headless = 0;
+    vibe.wav_path = NULL;
+    vibe.virtual_clock = 0;
+
+    client_socket = NULL;
+    daemon_socket = NULL;
+    daemonize = 0;
+    slowdown_budget = 0.0;
+    quiet_threshold = 0.0;
+    attach_pid = 0;
+
+    /* Parse options up to the program. */
+
+    while ((option = getopt(argc, argv, "+a:b:c:dj:np:q:r:s:t:vw:")) != -1) {
+        switch (option) {
+            case 'a':
+                vibe.analysis_frequency = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'b':
+                slowdown_budget = strtod(optarg, NULL) / 100.0;
+                break;
+
+            case 'c':
+                client_socket = optarg;
+                break;
+
+            case 'd':
+                daemonize = 1;
+                break;
+
+            case 'j':
+                vibe.analysis_workers =
+                    (unsigned int) strtoul(optarg, NULL, 10);
+                break;
+
+            case 'n':
+                vibe.headless = 1;
+                break;
+
+            case 'p':
+                attach_pid = (pid_t) strtol(optarg, NULL, 10);
+                break;
+
+            case 'q':
+                quiet_threshold = strtod(optarg, NULL);
+                break;
+
+            case 'r':
+                vibe.readahead = (unsigned int) strtoul(optarg, NULL, 10);
+                break;
+
+            case 's':
+                daemon_socket = optarg;
+                daemonize = 1;
+                break;
+
+            case 't':
+                vibe.timeline_name = optarg;
+                break;
+
+            case 'v':
+                vibe.virtual_clock = 1;
+                break;
+
+            case 'w':
+                vibe.wav_path = optarg;
+                vibe.headless = 1;
+                break;
+
+            default:
+                fprintf(
+                    stderr,
+                    "Usage: %s [options] [-q score] program [arguments...]\n"
+                    "       %s [options] [-q score] -p pid\n"
+                    "       %s -d [-s socket] [options] "
+                    "[program [arguments...]]\n"
+                    "       %s -c socket program [arguments...]\n"
+                    "Options: [-a frequency] [-b percent] [-j workers] [-n] "
+                    "[-r chunks] [-t timeline] [-v] [-w file]\n",
+                    argv[0], argv[0], argv[0], argv[0]
+                );
+
+                return 1;
+        }
+    }
 
-    vibexec_player_initialize();
-    vibexec_scheduler_initialize(&vibe);
+    program = optind < argc ? &argv[optind] : NULL;
 
-    if ((child_pid = fork()) == -1) {
-        fputs("Fork failed.\n", stderr);
+    if (!program && !attach_pid && !(daemonize && daemon_socket)) {
+        fputs("No program provided.\n", stderr);
         return 1;
     }
 
-    if (child_pid == 0) {
-        int status;
+    if (attach_pid && (program || daemonize || client_socket)) {
+        fputs("Attaching excludes programs and daemons.\n", stderr);
+        return 1;
+    }
 
-        /* Ask the parent to trace me. */
+    /* Hand the program over to a running daemon. */
 
-        status = ptrace(PTRACE_TRACEME, 0, 0, 0);
+    if (client_socket) {
+        long pid;
 
-        if (status == -1) {
-            fputs("Trace request failed.\n", stderr);
+        if ((pid = vibexec_daemon_submit(client_socket, program)) == -1) {
+            fputs("Daemon cannot trace program.\n", stderr);
             return 1;
         }
 
-        status = raise(SIGSTOP);
+        printf("%ld\n", pid);
+        return 0;
+    }
 
-        if (status) {
-            fputs("Waiting for parent failed.\n", stderr);
-            return 1;
-        }
+    /* Concurrent programs cannot share skipped pauses. */
 
-        /* Launch the actual application. */
+    if (daemonize && vibe.virtual_clock) {
+        fputs("Virtual clock requires a single program.\n", stderr);
+        return 1;
+    }
 
-        status = execvp(argv[1], &argv[1]);
+    /* The daemon keeps its programs traced, it never detaches them. */
 
-        /*
-         * The execvp call does not return, if successful. Branching only for
-         * esthetic reasons.
-         */
+    if (daemonize && quiet_threshold > 0.0) {
+        fputs("Quiet threshold requires a single program.\n", stderr);
+        return 1;
+    }
 
-        if (status) {
-            fprintf(stderr, "Failed launching '%s'.\n", argv[1]);
-            return 1;
-        }
+    if (vibexec_scheduler_initialize(&_scheduler, &vibe)) {
+        return 1;
+    }
 
-        return 0;
+    /* Trace many programs at once. */
+
+    if (daemonize) {
+        status = vibexec_daemon_run(
+            &_scheduler,
+            daemon_socket,
+            program,
+            slowdown_budget
+        );
+
+        vibexec_scheduler_cleanup(&_scheduler);
+
+        return status ? 1 : 0;
     }
 
-    /* Wait for child. */
+    /* Trace a single program until it terminated. */
+
+    vibexec_process_initialize(&process, slowdown_budget, quiet_threshold);
 
-    waitpid(child_pid, NULL, 0);
+    status = attach_pid
+        ? vibexec_process_attach(&process, attach_pid)
+        : vibexec_process_spawn(&process, program);
 
-    /* Loop until termination. */
+    if (!status) {
+        status = vibexec_process_run(&process, &_scheduler);
+    }
 
-    do {
-        vibexec_scheduler_yield_to_vibe();
-        ptrace(PTRACE_SYSCALL, child_pid, NULL, NULL);
-        waitpid(child_pid, &child_status, 0);
-    } while (!WIFEXITED(child_status) && !WIFSIGNALED(child_status));
+    vibexec_process_cleanup(&process);
+    vibexec_scheduler_cleanup(&_scheduler);
 
-    return 0;
+    return status ? 1 : 0;
 }
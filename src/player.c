@@ -1,138 +1,799 @@
+#include <math.h>
+#include <signal.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include <al.h>
 #include <alc.h>
+#include <alext.h>
 
 #include "player.h"
+#include "resampler.h"
 #include "scheduler.h"
 
-static ALuint _buffers[4], _source;
-static int started = 0;
+/* The null sink stays ahead of the clock by four one-second buffers. */
+#define NULL_SINK_AHEAD_NANOSECONDS 4000000000.0
 
-void vibexec_player_initialize(void) {
+/* Buffers of the scheduler that fit into the ring. */
+#define RING_CHUNKS 4
+
+/* The refill thread queues periods of a quarter second. */
+#define REFILL_PERIODS_PER_SECOND 4
+#define REFILL_INTERVAL_NANOSECONDS 50000000L
+
+static unsigned long _drain(
+    struct vibexec_player *player,
+    unsigned char *data,
+    unsigned long size
+);
+
+static int _resample(
+    struct vibexec_player *player,
+    struct vibexec_scheduled_buffer *buffer
+);
+
+#ifdef AL_SOFT_callback_buffer
+static ALsizei AL_APIENTRY _run_callback(
+    ALvoid *argument,
+    ALvoid *data,
+    ALsizei size
+);
+#endif
+
+static void *_run_refill(void *argument);
+static int _start(struct vibexec_player *player);
+static void _update_null_sink(struct vibexec_player *player);
+static int _write_wav_header(struct vibexec_player *player);
+static void _write_wav_integer(FILE *wav, unsigned long value, int size);
+
+void vibexec_player_cleanup(struct vibexec_player *player) {
+    unsigned long underruns;
+
+    if (player->sink == SINK_NULL) {
+        if (player->wav) {
+            /* Complete the header, now that the size is known. */
+
+            rewind(player->wav);
+            _write_wav_header(player);
+            fclose(player->wav);
+        }
+
+        return;
+    }
+
+    if (player->refill.running) {
+        atomic_store(&player->refill.stopping, 1);
+        pthread_join(player->refill.thread, NULL);
+    }
+
+    /* Stopping also ends the callbacks, before the ring is released. */
+
+    alSourceStop(player->source);
+
+    underruns = atomic_load(&player->underruns);
+
+    if (underruns) {
+        fprintf(
+            stderr,
+            "Playback ran dry %lu times, %lu frames of silence.\n",
+            underruns,
+            atomic_load(&player->underrun_frames)
+        );
+    }
+
+    if (player->resampling) {
+        vibexec_resampler_cleanup(&player->resampler);
+        free(player->cache.input);
+        free(player->cache.output);
+        free(player->cache.buffer);
+    }
+
+    alDeleteSources(1, &player->source);
+    alDeleteBuffers(4, player->buffers);
+    alcMakeContextCurrent(NULL);
+    alcDestroyContext(player->context);
+    alcCloseDevice(player->device);
+
+    free(player->refill.period);
+    free(player->ring.data);
+}
+
+int vibexec_player_initialize(
+    struct vibexec_player *player,
+    struct vibexec_scheduler *scheduler,
+    const struct vibexec_schedulable_vibe *vibe
+) {
     const char *deviceName;
-    ALCdevice *device;
-    ALCcontext *context;
-    
+    ALCint device_frequency;
+    unsigned int channels;
+    int sixteen_bit;
+
+    player->scheduler = scheduler;
+    player->started = 0;
+    player->start_failed = 0;
+    player->frequency = (ALCint) scheduler->parameters.sample_frequency;
+
+    player->resampling = 0;
+    player->cache.input = NULL;
+    player->cache.output = NULL;
+    player->cache.buffer = NULL;
+    player->cache.capacity = 0;
+
+    /* Without device, the vibe is consumed at the pace of the clock. */
+
+    if (vibe->headless) {
+        player->sink = SINK_NULL;
+        player->wav = NULL;
+        player->wav_data_size = 0;
+        player->queued_nanoseconds = 0.0;
+
+        if (!vibe->wav_path) {
+            return 0;
+        }
+
+        player->wav = fopen(vibe->wav_path, "wb");
+
+        if (!player->wav) {
+            fputs("Cannot create WAV file.\n", stderr);
+            return -1;
+        }
+
+        /* Reserve the header, it is completed during cleanup. */
+
+        if (_write_wav_header(player)) {
+            fclose(player->wav);
+            return -1;
+        }
+
+        return 0;
+    }
+
+    player->sink = SINK_OPENAL;
+
+    /* The ring holds the vibe in the format of the source. */
+
+    channels = scheduler->parameters.channels;
+    sixteen_bit = scheduler->parameters.sample_format == SIGNED_16BIT;
+
+    if (channels == 1) {
+        player->format = sixteen_bit ? AL_FORMAT_MONO16 : AL_FORMAT_MONO8;
+    } else if (channels == 2) {
+        player->format = sixteen_bit ? AL_FORMAT_STEREO16 : AL_FORMAT_STEREO8;
+    } else {
+        fputs("Unsupported format.\n", stderr);
+        goto error_return;
+    }
+
+    player->frame_size = channels * (sixteen_bit ? 2 : 1);
+    player->silence = sixteen_bit ? 0x00 : 0x80;
+
     deviceName = alcGetString(NULL, ALC_DEFAULT_DEVICE_SPECIFIER);
-    device = alcOpenDevice(deviceName);
-    context = alcCreateContext(device, NULL);
-    alcMakeContextCurrent(context);
+    player->device = alcOpenDevice(deviceName);
+
+    if (!player->device) {
+        fputs("Cannot open audio device.\n", stderr);
+        goto error_return;
+    }
+
+    player->context = alcCreateContext(player->device, NULL);
+
+    if (!player->context || !alcMakeContextCurrent(player->context)) {
+        fputs("Cannot create audio context.\n", stderr);
+        goto error_cleanup_context;
+    }
+
+    alGetError();
+    alGenSources(1, &player->source);
+    alGenBuffers(4, player->buffers);
+
+    if (alGetError() != AL_NO_ERROR) {
+        fputs("Cannot create audio source.\n", stderr);
+        goto error_cleanup_context;
+    }
+
+    /* Resample on our own, if the device runs at a different frequency. */
+
+    device_frequency = 0;
+    alcGetIntegerv(player->device, ALC_FREQUENCY, 1, &device_frequency);
+
+    if (device_frequency > 0 && device_frequency != player->frequency) {
+        int failure;
+
+        failure = vibexec_resampler_initialize(
+            &player->resampler,
+            channels,
+            scheduler->parameters.sample_frequency,
+            (unsigned long) device_frequency
+        );
+
+        if (!failure) {
+            player->frequency = device_frequency;
+            player->resampling = 1;
+        }
+    }
 
-    alGenSources(1, &_source);
-    alGenBuffers(4, _buffers);
+    /* Size the ring for the read-ahead of the former buffer queue. */
+
+    player->chunk_capacity = scheduler->cache.buffer_size;
+
+    if (player->resampling) {
+        player->chunk_capacity = player->frame_size
+            * vibexec_resampler_output_frames(
+                &player->resampler,
+                scheduler->cache.buffer_size / player->frame_size
+            );
+    }
+
+    player->ring.capacity = RING_CHUNKS * player->chunk_capacity;
+    player->ring.data = malloc(player->ring.capacity);
+
+    if (!player->ring.data) {
+        fputs("Cannot allocate memory.\n", stderr);
+        goto error_cleanup_resampler;
+    }
+
+    atomic_init(&player->ring.head, 0);
+    atomic_init(&player->ring.tail, 0);
+    atomic_init(&player->ring.finished, 0);
+    atomic_init(&player->underruns, 0);
+    atomic_init(&player->underrun_frames, 0);
+
+    player->refill.period = NULL;
+    player->refill.running = 0;
+    atomic_init(&player->refill.stopping, 0);
+
+    /* Let the mixer pull from the ring, if OpenAL supports it. */
+
+#ifdef AL_SOFT_callback_buffer
+    if (alIsExtensionPresent("AL_SOFT_callback_buffer")) {
+        LPALBUFFERCALLBACKSOFT alBufferCallbackSOFT;
+
+        alBufferCallbackSOFT = (LPALBUFFERCALLBACKSOFT)
+            alGetProcAddress("alBufferCallbackSOFT");
+
+        if (alBufferCallbackSOFT) {
+            alBufferCallbackSOFT(
+                player->buffers[0],
+                player->format,
+                player->frequency,
+                _run_callback,
+                player
+            );
+
+            alSourcei(player->source, AL_BUFFER, (ALint) player->buffers[0]);
+
+            if (alGetError() == AL_NO_ERROR) {
+                player->playback = PLAYBACK_CALLBACK;
+                return 0;
+            }
+
+            alSourcei(player->source, AL_BUFFER, 0);
+        }
+    }
+#endif
+
+    player->playback = PLAYBACK_THREAD;
+    player->refill.period_size = player->frame_size
+        * (unsigned long) (player->frequency / REFILL_PERIODS_PER_SECOND);
+    player->refill.period = malloc(player->refill.period_size);
+
+    if (!player->refill.period) {
+        fputs("Cannot allocate memory.\n", stderr);
+        goto error_cleanup_ring;
+    }
+
+    return 0;
+
+error_cleanup_ring:
+    free(player->ring.data);
+error_cleanup_resampler:
+    if (player->resampling) {
+        vibexec_resampler_cleanup(&player->resampler);
+    }
+
+    alDeleteSources(1, &player->source);
+    alDeleteBuffers(4, player->buffers);
+error_cleanup_context:
+    alcMakeContextCurrent(NULL);
+
+    if (player->context) {
+        alcDestroyContext(player->context);
+    }
+
+    alcCloseDevice(player->device);
+error_return:
+    return -1;
 }
 
-void vibexec_player_update(void) {
-    ALint sourceState, processedBuffers;
+void vibexec_player_update(struct vibexec_player *player) {
+    struct timespec now, difference;
+
+    if (player->sink == SINK_NULL) {
+        _update_null_sink(player);
+        return;
+    }
 
-    alGetSourcei(_source, AL_SOURCE_STATE, &sourceState);
+    /*
+     * Top up the ring with whole buffers. Only this thread writes, hence the
+     * head and the end flag are known without synchronization.
+     */
 
-    if (!started) {
+    while (
+        !atomic_load_explicit(&player->ring.finished, memory_order_relaxed)
+    ) {
         struct vibexec_scheduled_buffer buffer;
-        int i;
-
-        for (i = 0; i < 4; i++) {
-            ALenum format;
-
-            vibexec_scheduler_next_buffer(&buffer);
-
-            switch (buffer.parameters->sample_format) {
-                case SIGNED_8BIT:
-                    if (buffer.parameters->channels == 1) {
-                        format = AL_FORMAT_MONO8;
-                        break;
-                    }
-
-                    if (buffer.parameters->channels == 2) {
-                        format = AL_FORMAT_STEREO8;
-                        break;
-                    }
-
-                case SIGNED_16BIT:
-                    if (buffer.parameters->channels == 1) {
-                        format = AL_FORMAT_MONO16;
-                        break;
-                    }
-
-                    if (buffer.parameters->channels == 2) {
-                        format = AL_FORMAT_STEREO16;
-                        break;
-                    }
-
-                default:
-                    fputs("Unsupported format.\n", stderr);
-                    return;
-            }
+        unsigned long head, tail, offset, part;
 
-            alBufferData(
-                _buffers[i],
-                format,
-                buffer.buffer, buffer.buffer_size,
-                buffer.parameters->sample_frequency
+        head = atomic_load_explicit(&player->ring.head, memory_order_relaxed);
+        tail = atomic_load_explicit(&player->ring.tail, memory_order_acquire);
+
+        if (player->ring.capacity - (head - tail) < player->chunk_capacity) {
+            break;
+        }
+
+        if (vibexec_scheduler_next_buffer(player->scheduler, &buffer)) {
+            /* The vibe is over. */
+
+            atomic_store_explicit(
+                &player->ring.finished,
+                1,
+                memory_order_release
             );
+
+            break;
+        }
+
+        if (_resample(player, &buffer)) {
+            return;
+        }
+
+        offset = head % player->ring.capacity;
+        part = player->ring.capacity - offset;
+
+        if (part > buffer.buffer_size) {
+            part = buffer.buffer_size;
         }
 
-        alSourceQueueBuffers(_source, 4, _buffers);
-        alSourcePlay(_source);
-        started = 1;
+        memcpy(player->ring.data + offset, buffer.buffer, part);
+        memcpy(
+            player->ring.data,
+            (const unsigned char *) buffer.buffer + part,
+            buffer.buffer_size - part
+        );
 
+        atomic_store_explicit(
+            &player->ring.head,
+            head + buffer.buffer_size,
+            memory_order_release
+        );
+    }
+
+    /* The vibe may be empty. */
+
+    if (
+        player->started
+        || !atomic_load_explicit(&player->ring.head, memory_order_relaxed)
+    ) {
         return;
     }
 
-    alGetSourcei(_source, AL_BUFFERS_PROCESSED, &processedBuffers);
+    /* Updates run on every stop, hence failures are retried less often. */
 
-    while (processedBuffers)
-    {
-        ALint target;
-        ALenum format;
-        struct vibexec_scheduled_buffer buffer;
-        alSourceUnqueueBuffers(_source, 1, &target);
-
-        vibexec_scheduler_next_buffer(&buffer);
-        
-        switch (buffer.parameters->sample_format) {
-            case SIGNED_8BIT:
-                if (buffer.parameters->channels == 1) {
-                    format = AL_FORMAT_MONO8;
-                    break;
-                }
-
-                if (buffer.parameters->channels == 2) {
-                    format = AL_FORMAT_STEREO8;
-                    break;
-                }
-
-            case SIGNED_16BIT:
-                if (buffer.parameters->channels == 1) {
-                    format = AL_FORMAT_MONO16;
-                    break;
-                }
-
-                if (buffer.parameters->channels == 2) {
-                    format = AL_FORMAT_STEREO16;
-                    break;
-                }
-
-            default:
-                fputs("Unsupported format.\n", stderr);
-                return;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (player->start_failed) {
+        _compute_difference(&difference, &now, &player->start_failure);
+
+        if (
+            !difference.tv_sec
+            && difference.tv_nsec < VIBEXEC_PLAYER_INTERVAL_NANOSECONDS
+        ) {
+            return;
+        }
+    }
+
+    if (_start(player)) {
+        if (!player->start_failed) {
+            fputs("Cannot start playback thread, retrying.\n", stderr);
+        }
+
+        player->start_failed = 1;
+        player->start_failure = now;
+        return;
+    }
+
+    player->started = 1;
+}
+
+static unsigned long _drain(
+    struct vibexec_player *player,
+    unsigned char *data,
+    unsigned long size
+) {
+    unsigned long head, tail, available, offset, part;
+    int finished;
+
+    /* The end flag comes first, all writes before it are visible then. */
+
+    finished = atomic_load_explicit(
+        &player->ring.finished,
+        memory_order_acquire
+    );
+
+    head = atomic_load_explicit(&player->ring.head, memory_order_acquire);
+    tail = atomic_load_explicit(&player->ring.tail, memory_order_relaxed);
+
+    available = head - tail < size ? head - tail : size;
+    offset = tail % player->ring.capacity;
+    part = player->ring.capacity - offset;
+
+    if (part > available) {
+        part = available;
+    }
+
+    memcpy(data, player->ring.data + offset, part);
+    memcpy(data + part, player->ring.data, available - part);
+
+    atomic_store_explicit(
+        &player->ring.tail,
+        tail + available,
+        memory_order_release
+    );
+
+    /* Returning less data ends the playback. */
+
+    if (available == size || finished) {
+        return available;
+    }
+
+    /* Otherwise, bridge with silence until the scheduler catches up. */
+
+    memset(data + available, player->silence, size - available);
+
+    atomic_fetch_add_explicit(&player->underruns, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(
+        &player->underrun_frames,
+        (size - available) / player->frame_size,
+        memory_order_relaxed
+    );
+
+    return size;
+}
+
+static int _resample(
+    struct vibexec_player *player,
+    struct vibexec_scheduled_buffer *buffer
+) {
+    unsigned long frame_size, frame_count, output_count, sample;
+    unsigned int channels;
+    long resampled_count;
+
+    if (!player->resampling) {
+        return 0;
+    }
+
+    channels = buffer->parameters->channels;
+    frame_size = buffer->parameters->sample_format == SIGNED_16BIT
+        ? 2 * channels
+        : channels;
+
+    frame_count = buffer->buffer_size / frame_size;
+    output_count = vibexec_resampler_output_frames(
+        &player->resampler,
+        frame_count
+    );
+
+    /* Grow the conversion buffers, if necessary. */
+
+    if (frame_count > player->cache.capacity) {
+        float *input, *output;
+        void *converted;
+
+        input = realloc(
+            player->cache.input,
+            sizeof(float) * channels * frame_count
+        );
+
+        if (input) {
+            player->cache.input = input;
+        }
+
+        output = realloc(
+            player->cache.output,
+            sizeof(float) * channels * output_count
+        );
+
+        if (output) {
+            player->cache.output = output;
+        }
+
+        converted = realloc(player->cache.buffer, frame_size * output_count);
+
+        if (converted) {
+            player->cache.buffer = converted;
+        }
+
+        if (!input || !output || !converted) {
+            fputs("Cannot allocate memory.\n", stderr);
+            return -1;
+        }
+
+        player->cache.capacity = frame_count;
+    }
+
+    /* Convert to float, resample and convert back. */
+
+    for (sample = 0; sample < frame_count * channels; sample++) {
+        player->cache.input[sample] =
+            buffer->parameters->sample_format == SIGNED_16BIT
+                ? ((const short *) buffer->buffer)[sample] / 32768.0F
+                : ((const char *) buffer->buffer)[sample] / 128.0F;
+    }
+
+    resampled_count = vibexec_resampler_process(
+        &player->resampler,
+        player->cache.input,
+        frame_count,
+        player->cache.output
+    );
+
+    if (resampled_count < 0) {
+        return -1;
+    }
+
+    for (sample = 0; sample < resampled_count * channels; sample++) {
+        float amplitude = player->cache.output[sample];
+
+        if (amplitude > 1.0F) amplitude = 1.0F;
+        if (amplitude < -1.0F) amplitude = -1.0F;
+
+        if (buffer->parameters->sample_format == SIGNED_16BIT) {
+            ((short *) player->cache.buffer)[sample] =
+                (short) lrintf(amplitude * 32767.0F);
+        } else {
+            ((char *) player->cache.buffer)[sample] =
+                (char) lrintf(amplitude * 127.0F);
+        }
+    }
+
+    buffer->buffer = player->cache.buffer;
+    buffer->buffer_size = (unsigned int) (resampled_count * frame_size);
+
+    return 0;
+}
+
+#ifdef AL_SOFT_callback_buffer
+static ALsizei AL_APIENTRY _run_callback(
+    ALvoid *argument,
+    ALvoid *data,
+    ALsizei size
+) {
+    /* Runs on the mixer thread of OpenAL. */
+
+    return (ALsizei) _drain(argument, data, (unsigned long) size);
+}
+#endif
+
+static void *_run_refill(void *argument) {
+    struct vibexec_player *player;
+    struct timespec interval;
+    unsigned long size;
+    int i;
+
+    player = argument;
+    interval.tv_sec = 0;
+    interval.tv_nsec = REFILL_INTERVAL_NANOSECONDS;
+
+    /* Prime the queue of the source. */
+
+    for (i = 0; i < 4; i++) {
+        size = _drain(
+            player,
+            player->refill.period,
+            player->refill.period_size
+        );
+
+        if (!size) {
+            /* The vibe is shorter than the queue. */
+            break;
         }
 
         alBufferData(
-            target,
-            format,
-            buffer.buffer, buffer.buffer_size,
-            buffer.parameters->sample_frequency
+            player->buffers[i],
+            player->format,
+            player->refill.period, (ALsizei) size,
+            player->frequency
         );
+    }
+
+    alSourceQueueBuffers(player->source, i, player->buffers);
+    alSourcePlay(player->source);
+
+    while (!atomic_load(&player->refill.stopping)) {
+        ALint processed, queued, state;
+
+        alGetSourcei(player->source, AL_BUFFERS_PROCESSED, &processed);
+
+        for (; processed > 0; processed--) {
+            unsigned long size;
+            ALuint target;
+
+            alSourceUnqueueBuffers(player->source, 1, &target);
+
+            size = _drain(
+                player,
+                player->refill.period,
+                player->refill.period_size
+            );
+
+            if (!size) {
+                /* The vibe is over. */
+                continue;
+            }
+
+            alBufferData(
+                target,
+                player->format,
+                player->refill.period, (ALsizei) size,
+                player->frequency
+            );
+
+            alSourceQueueBuffers(player->source, 1, &target);
+        }
+
+        /* Resume, if the queue ran dry meanwhile. */
+
+        alGetSourcei(player->source, AL_BUFFERS_QUEUED, &queued);
+        alGetSourcei(player->source, AL_SOURCE_STATE, &state);
+
+        if (queued && state != AL_PLAYING) {
+            alSourcePlay(player->source);
+        }
+
+        nanosleep(&interval, NULL);
+    }
+
+    return NULL;
+}
+
+static int _start(struct vibexec_player *player) {
+    sigset_t signals, previous_signals;
+    int failure;
+
+    if (player->playback == PLAYBACK_CALLBACK) {
+        alSourcePlay(player->source);
+        return 0;
+    }
+
+    /*
+     * The thread primes the queue itself, such that nothing is played yet if
+     * it cannot be created, and the next update can retry.
+     */
+
+    /* Like the reader, leave all signals to the tracing thread. */
+
+    sigfillset(&signals);
+    pthread_sigmask(SIG_SETMASK, &signals, &previous_signals);
+
+    failure = pthread_create(
+        &player->refill.thread,
+        NULL,
+        _run_refill,
+        player
+    );
+
+    pthread_sigmask(SIG_SETMASK, &previous_signals, NULL);
 
-        alSourceQueueBuffers(_source, 1, &target);
-        processedBuffers--;
+    if (failure) {
+        return -1;
     }
 
-    if (sourceState != AL_PLAYING) {
-        alSourcePlay(_source);
+    player->refill.running = 1;
+    return 0;
+}
+
+static void _update_null_sink(struct vibexec_player *player) {
+    struct timespec now;
+    double frame_size;
+
+    /*
+     * Like the queue of the OpenAL source, stay ahead of the clock. A buffer
+     * counts as played once queued.
+     */
+
+    vibexec_scheduler_now(player->scheduler, &now);
+
+    frame_size = player->scheduler->parameters.channels
+        * (player->scheduler->parameters.sample_format == SIGNED_16BIT
+            ? 2
+            : 1);
+
+    while (
+        player->queued_nanoseconds
+            < now.tv_sec * 1000000000.0 + now.tv_nsec
+                + NULL_SINK_AHEAD_NANOSECONDS
+    ) {
+        struct vibexec_scheduled_buffer buffer;
+
+        if (vibexec_scheduler_next_buffer(player->scheduler, &buffer)) {
+            /* The vibe is over. */
+            return;
+        }
+
+        player->queued_nanoseconds +=
+            1000000000.0 * (buffer.buffer_size / frame_size)
+            / player->frequency;
+
+        if (!player->wav) {
+            continue;
+        }
+
+        /* WAV stores 8 bit samples unsigned. */
+
+        if (buffer.parameters->sample_format == SIGNED_8BIT) {
+            unsigned int i;
+
+            for (i = 0; i < buffer.buffer_size; i++) {
+                fputc(
+                    ((const unsigned char *) buffer.buffer)[i] ^ 0x80,
+                    player->wav
+                );
+            }
+        } else {
+            fwrite(buffer.buffer, 1, buffer.buffer_size, player->wav);
+        }
+
+        player->wav_data_size += buffer.buffer_size;
+    }
+}
+
+static int _write_wav_header(struct vibexec_player *player) {
+    unsigned long bits, block_align;
+
+    bits = player->scheduler->parameters.sample_format == SIGNED_16BIT
+        ? 16
+        : 8;
+
+    block_align = player->scheduler->parameters.channels * bits / 8;
+
+    fputs("RIFF", player->wav);
+    _write_wav_integer(player->wav, 36 + player->wav_data_size, 4);
+    fputs("WAVEfmt ", player->wav);
+    _write_wav_integer(player->wav, 16, 4);
+    _write_wav_integer(player->wav, 1, 2);
+    _write_wav_integer(
+        player->wav,
+        player->scheduler->parameters.channels,
+        2
+    );
+    _write_wav_integer(player->wav, (unsigned long) player->frequency, 4);
+    _write_wav_integer(
+        player->wav,
+        (unsigned long) player->frequency * block_align,
+        4
+    );
+    _write_wav_integer(player->wav, block_align, 2);
+    _write_wav_integer(player->wav, bits, 2);
+    fputs("data", player->wav);
+    _write_wav_integer(player->wav, player->wav_data_size, 4);
+
+    if (ferror(player->wav)) {
+        fputs("Cannot write WAV file.\n", stderr);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void _write_wav_integer(FILE *wav, unsigned long value, int size) {
+    int i;
+
+    /* Little endian, regardless of the host. */
+
+    for (i = 0; i < size; i++) {
+        fputc((int) ((value >> (8 * i)) & 0xFF), wav);
     }
 }
@@ -1,7 +1,129 @@
 #ifndef _VIBEXEC_PLAYER_H_
 #define _VIBEXEC_PLAYER_H_
 
-void vibexec_player_initialize(void);
-void vibexec_player_update(void);
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+#include <al.h>
+#include <alc.h>
+#include "resampler.h"
+
+/* Interval of playback updates, while no tracee stops. */
+#define VIBEXEC_PLAYER_INTERVAL_NANOSECONDS 100000000L
+
+struct vibexec_scheduler;
+struct vibexec_schedulable_vibe;
+
+/*
+ * Plays the vibe of the scheduler, either on the default OpenAL device or on
+ * a null sink, which consumes the vibe as the clock of the scheduler advances
+ * and optionally renders it into a WAV file.
+ *
+ * The scheduler only fills a ring of PCM on the OpenAL sink, which OpenAL
+ * drains on its own: through AL_SOFT_callback_buffer, if available, otherwise
+ * by a thread that requeues the buffers of the source periodically. Hence,
+ * updates do not call into OpenAL once the playback started.
+ */
+struct vibexec_player {
+    struct vibexec_scheduler *scheduler;
+
+    enum {
+        SINK_OPENAL,
+        SINK_NULL
+    } sink;
+
+    /* OpenAL sink. */
+
+    ALCdevice *device;
+    ALCcontext *context;
+    ALuint buffers[4], source;
+    ALenum format;
+    int started;
+
+    /* Time of the last failed start, which is retried once per interval. */
+
+    int start_failed;
+    struct timespec start_failure;
+
+    enum {
+        PLAYBACK_CALLBACK,
+        PLAYBACK_THREAD
+    } playback;
+
+    /*
+     * Single-producer single-consumer ring of PCM in the format of the
+     * source. Head and tail count the bytes that were written and read in
+     * total, the ring holds their difference.
+     */
+
+    struct {
+        unsigned char *data;
+        unsigned long capacity;
+        _Atomic unsigned long head;
+        _Atomic unsigned long tail;
+
+        /* Set, once the vibe is written completely. */
+
+        atomic_int finished;
+    } ring;
+
+    unsigned long frame_size;
+    unsigned char silence;
+
+    /* Largest buffer of the scheduler after resampling, in bytes. */
+
+    unsigned long chunk_capacity;
+
+    /* Thread-based fallback, requeueing one period per processed buffer. */
+
+    struct {
+        pthread_t thread;
+        unsigned char *period;
+        unsigned long period_size;
+        atomic_int stopping;
+        int running;
+    } refill;
+
+    /*
+     * Times the ring ran dry while playing and frames of silence that were
+     * played instead. Written by the audio side, read with atomic_load.
+     */
+
+    _Atomic unsigned long underruns;
+    _Atomic unsigned long underrun_frames;
+
+    /* Resampling to the device frequency, if the vibe does not match it. */
+
+    ALCint frequency;
+    int resampling;
+    struct vibexec_resampler resampler;
+
+    /* Null sink. */
+
+    FILE *wav;
+    unsigned long wav_data_size;
+    double queued_nanoseconds;
+
+    struct {
+        float *input;
+        float *output;
+        void *buffer;
+        unsigned long capacity;
+    } cache;
+};
+
+void vibexec_player_cleanup(struct vibexec_player *player);
+int vibexec_player_initialize(
+    struct vibexec_player *player,
+    struct vibexec_scheduler *scheduler,
+    const struct vibexec_schedulable_vibe *vibe
+);
+
+/*
+ * Keeps the playback ahead of the clock. Cheap, while the ring is full, such
+ * that it can run on every stop of the tracee.
+ */
+void vibexec_player_update(struct vibexec_player *player);
 
 #endif
@@ -0,0 +1,302 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "preanalyzer.h"
+#include "vibeomatic.h"
+
+/* Number of windows that a worker reads and analyzes at once. */
+#define WINDOWS_PER_READ 64
+
+struct _worker {
+    pthread_t thread;
+    const struct vibexec_vibeomatic_session *template;
+    int source_descriptor;
+
+    /* Chunk boundaries in windows, excluding the overlap: [first, limit) */
+
+    unsigned long first_window;
+    unsigned long window_limit;
+    unsigned long overlap;
+
+    /*
+     * End of the bytes read, including the lookahead of the filter delay, and
+     * the number of scores kept, if the lookahead completes further windows.
+     */
+
+    unsigned long read_limit;
+    unsigned long score_limit;
+
+    struct vibexec_vibeomatic_session session;
+    int failure;
+};
+
+static void *_run_worker(void *argument);
+
+int vibexec_preanalyzer_run(
+    struct vibexec_vibeomatic_session *session,
+    FILE *source,
+    unsigned int worker_count
+) {
+    struct _worker *workers;
+    struct stat source_stat;
+    unsigned long window_count, windows_per_worker, overlap, lookahead;
+    unsigned long source_size;
+    unsigned int i, started_workers;
+    int failure;
+
+    if (!worker_count) {
+        fputs("No pre-analysis workers requested.\n", stderr);
+        return -1;
+    }
+
+    /* Determine the number of complete windows in the source. */
+
+    if (fstat(fileno(source), &source_stat)) {
+        fputs("Cannot determine vibe size.\n", stderr);
+        return -1;
+    }
+
+    /* Streams can neither be sized nor read concurrently. */
+
+    if (!S_ISREG(source_stat.st_mode)) {
+        fputs(
+            "Vibe is not a regular file, analyzing it during playback.\n",
+            stderr
+        );
+
+        return 1;
+    }
+
+    source_size = (unsigned long) source_stat.st_size;
+    source_size -= source_size % session->cache.frame_size_in_bytes;
+    window_count = source_size / session->cache.window_size_in_bytes;
+
+    if (!window_count) {
+        return 1;
+    }
+
+    if (worker_count > window_count) {
+        worker_count = (unsigned int) window_count;
+    }
+
+    windows_per_worker = (window_count + worker_count - 1) / worker_count;
+    worker_count = (unsigned int)
+        ((window_count + windows_per_worker - 1) / windows_per_worker);
+
+    /*
+     * Besides the window that provides the previous spectrum, the overlap
+     * must cover the history of the decimation filter. As the filter delay is
+     * compensated, a chunk's last window also needs a few frames beyond it.
+     */
+
+    overlap = 1;
+    lookahead = 0;
+
+    if (session->decimation > 1) {
+        unsigned long window_frames, history_frames;
+
+        window_frames = session->sample_window_size * session->decimation;
+        history_frames = session->cache.resampler.taps_per_phase - 1;
+        overlap += (history_frames + window_frames - 1) / window_frames;
+        lookahead = session->cache.resampler.delay
+            * session->cache.frame_size_in_bytes;
+    }
+
+    /* Prepare the workers. */
+
+    workers = calloc(worker_count, sizeof(struct _worker));
+
+    if (!workers) {
+        fputs("Cannot allocate memory.\n", stderr);
+        return -1;
+    }
+
+    for (i = 0; i < worker_count; i++) {
+        workers[i].template = session;
+        workers[i].source_descriptor = fileno(source);
+        workers[i].first_window = i * windows_per_worker;
+        workers[i].window_limit = workers[i].first_window + windows_per_worker;
+        workers[i].overlap = i ? overlap : 0;
+
+        if (workers[i].window_limit > window_count) {
+            workers[i].window_limit = window_count;
+        }
+
+        if (workers[i].overlap > workers[i].first_window) {
+            workers[i].overlap = workers[i].first_window;
+        }
+
+        workers[i].read_limit =
+            workers[i].window_limit * session->cache.window_size_in_bytes
+            + lookahead;
+
+        workers[i].score_limit =
+            1 + workers[i].overlap
+            + workers[i].window_limit - workers[i].first_window;
+
+        if (workers[i].read_limit > source_size || i == worker_count - 1) {
+            workers[i].read_limit = source_size;
+        }
+
+        if (i == worker_count - 1) {
+            workers[i].score_limit = 0;
+        }
+    }
+
+    /* Analyze the chunks concurrently. */
+
+    for (
+        started_workers = 0;
+        started_workers < worker_count;
+        started_workers++
+    ) {
+        failure = pthread_create(
+            &workers[started_workers].thread,
+            NULL,
+            _run_worker,
+            &workers[started_workers]
+        );
+
+        if (failure) {
+            fputs("Cannot start pre-analysis worker.\n", stderr);
+            break;
+        }
+    }
+
+    failure = started_workers < worker_count;
+
+    for (i = 0; i < started_workers; i++) {
+        pthread_join(workers[i].thread, NULL);
+        failure |= workers[i].failure;
+    }
+
+    /*
+     * Stitch the score arrays. Each worker session starts with the fixed
+     * initial score, followed by the scores of the overlapping windows, all of
+     * which are already covered by the target session or the predecessor.
+     */
+
+    for (i = 0; i < started_workers; i++) {
+        unsigned long skipped_scores;
+
+        if (failure || workers[i].failure) {
+            goto next_worker;
+        }
+
+        skipped_scores = 1 + workers[i].overlap;
+
+        if (workers[i].session.cache.score_buffer_limit < skipped_scores) {
+            goto next_worker;
+        }
+
+        failure = vibexec_vibeomatic_append_scores(
+            session,
+            workers[i].session.cache.score_buffer + skipped_scores,
+            workers[i].session.cache.score_buffer_limit - skipped_scores
+        );
+
+next_worker:
+        if (!workers[i].failure) {
+            vibexec_vibeomatic_cleanup(&workers[i].session);
+        }
+    }
+
+    free(workers);
+
+    if (failure) {
+        fputs("Pre-analysis failed.\n", stderr);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void *_run_worker(void *argument) {
+    struct _worker *worker;
+    unsigned long offset, slice_size;
+    char *buffer;
+
+    worker = argument;
+    slice_size = worker->template->cache.window_size_in_bytes
+        * WINDOWS_PER_READ;
+
+    /* Every worker owns its FFT configuration. */
+
+    worker->failure = vibexec_vibeomatic_initialize(
+        &worker->session,
+        worker->template->parameters,
+        worker->template->sample_window_size,
+        worker->template->decimation
+    );
+
+    if (worker->failure) {
+        return NULL;
+    }
+
+    buffer = malloc(slice_size);
+
+    if (!buffer) {
+        fputs("Cannot allocate memory.\n", stderr);
+        goto error_cleanup_session;
+    }
+
+    for (
+        offset = (worker->first_window - worker->overlap)
+            * worker->template->cache.window_size_in_bytes;
+        offset < worker->read_limit;
+    ) {
+        unsigned long read_size, buffer_fill;
+
+        read_size = worker->read_limit - offset;
+
+        if (read_size > slice_size) {
+            read_size = slice_size;
+        }
+
+        /* Read the complete slice, handling short reads. */
+
+        for (buffer_fill = 0; buffer_fill < read_size;) {
+            ssize_t status;
+
+            status = pread(
+                worker->source_descriptor,
+                buffer + buffer_fill,
+                read_size - buffer_fill,
+                (off_t) (offset + buffer_fill)
+            );
+
+            if (status <= 0) {
+                fputs("Cannot read vibe.\n", stderr);
+                goto error_cleanup_buffer;
+            }
+
+            buffer_fill += (unsigned long) status;
+        }
+
+        vibexec_vibeomatic_analyze(&worker->session, buffer, read_size);
+        offset += read_size;
+    }
+
+    /* Drop the scores of windows that belong to the successor. */
+
+    if (
+        worker->score_limit
+        && worker->session.cache.score_buffer_limit > worker->score_limit
+    ) {
+        worker->session.cache.score_buffer_limit = worker->score_limit;
+    }
+
+    free(buffer);
+    return NULL;
+
+error_cleanup_buffer:
+    free(buffer);
+error_cleanup_session:
+    vibexec_vibeomatic_cleanup(&worker->session);
+    worker->failure = -1;
+    return NULL;
+}
@@ -0,0 +1,26 @@
+#ifndef _VIBEXEC_PREANALYZER_H_
+#define _VIBEXEC_PREANALYZER_H_
+
+#include <stdio.h>
+#include "vibeomatic.h"
+
+/*
+ * Analyzes the whole source in advance and appends the resulting score
+ * timeline to the (freshly initialized) session.
+ *
+ * The source is split into worker_count chunks of complete windows, each of
+ * which is analyzed on its own thread with its own FFT configuration. Every
+ * chunk but the first one overlaps its predecessor by one window (plus the
+ * history of the decimation filter), such that the stitched scores equal
+ * those of a sequential analysis.
+ *
+ * Returns 1 without touching the session, if the source is not a regular file
+ * or holds no complete window, such that it has to be analyzed while played.
+ */
+int vibexec_preanalyzer_run(
+    struct vibexec_vibeomatic_session *session,
+    FILE *source,
+    unsigned int worker_count
+);
+
+#endif
@@ -0,0 +1,468 @@
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/ptrace.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "governor.h"
+#include "player.h"
+#include "process.h"
+#include "scheduler.h"
+#include "tracee.h"
+
+/* Quiet spans shorter than this are not worth detaching. */
+#define QUIET_MINIMUM_NANOSECONDS 1000000000.0
+
+/* Time ahead of the next low score, at which the process is seized again. */
+#define RESEIZE_LEAD_NANOSECONDS 100000000.0
+
+static struct vibexec_process_thread *_add_thread(
+    struct vibexec_process *process,
+    pid_t pid
+);
+
+static struct vibexec_process_thread *_find_thread(
+    struct vibexec_process *process,
+    pid_t pid
+);
+
+static void _handle_stop(void *context, pid_t pid, int status);
+
+static void _remove_thread(
+    struct vibexec_process *process,
+    struct vibexec_process_thread *thread
+);
+
+static double _resume_due_threads(struct vibexec_process *process);
+static void _seize(struct vibexec_process *process);
+
+void vibexec_process_cleanup(struct vibexec_process *process) {
+    free(process->threads);
+}
+
+void vibexec_process_initialize(
+    struct vibexec_process *process,
+    double slowdown_budget,
+    double quiet_threshold
+) {
+    memset(process, 0, sizeof(struct vibexec_process));
+
+    process->slowdown_budget = slowdown_budget;
+    process->quiet_threshold = quiet_threshold;
+}
+
+int vibexec_process_attach(struct vibexec_process *process, pid_t pid) {
+    process->pid = pid;
+    process->spawned = 0;
+
+    _seize(process);
+
+    if (!process->thread_count) {
+        fputs("Cannot attach to process.\n", stderr);
+        return -1;
+    }
+
+    return 0;
+}
+
+int vibexec_process_spawn(
+    struct vibexec_process *process,
+    char *const program[]
+) {
+    struct vibexec_process_thread *thread;
+
+    thread = _add_thread(process, 0);
+
+    if (!thread) {
+        return -1;
+    }
+
+    if (vibexec_tracee_spawn(&thread->tracee, program)) {
+        _remove_thread(process, thread);
+        return -1;
+    }
+
+    process->pid = thread->tracee.pid;
+    process->spawned = 1;
+
+    /* Follow new threads, spawning only asks for system call and exec stops. */
+
+    ptrace(
+        PTRACE_SETOPTIONS,
+        process->pid,
+        NULL,
+        (void *) (long) (
+            PTRACE_O_TRACESYSGOOD
+            | PTRACE_O_TRACECLONE
+            | PTRACE_O_TRACEEXEC
+        )
+    );
+
+    return vibexec_tracee_resume(&thread->tracee);
+}
+
+int vibexec_process_run(
+    struct vibexec_process *process,
+    struct vibexec_scheduler *scheduler
+) {
+    sigset_t signals, previous_signals;
+
+    /* Stops are awaited with a timeout, which keeps the playback going. */
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &signals, &previous_signals);
+
+    process->scheduler = scheduler;
+
+    while (!process->exited) {
+        struct timespec timeout;
+        double wait_time;
+
+        vibexec_tracee_collect_stops(_handle_stop, process);
+
+        if (!process->thread_count && !process->quiet) {
+            break;
+        }
+
+        /* Sleep until the next pause ends, at most until the next update. */
+
+        wait_time = _resume_due_threads(process);
+
+        if (wait_time > VIBEXEC_PLAYER_INTERVAL_NANOSECONDS) {
+            wait_time = VIBEXEC_PLAYER_INTERVAL_NANOSECONDS;
+        }
+
+        /* While quiet, seize again shortly before the vibe gets louder. */
+
+        if (process->quiet) {
+            double span;
+
+            span = vibexec_scheduler_quiet_span(
+                scheduler,
+                process->quiet_threshold,
+                VIBEXEC_PLAYER_INTERVAL_NANOSECONDS + RESEIZE_LEAD_NANOSECONDS
+            );
+
+            if (span <= RESEIZE_LEAD_NANOSECONDS) {
+                _seize(process);
+                continue;
+            }
+
+            if (span - RESEIZE_LEAD_NANOSECONDS < wait_time) {
+                wait_time = span - RESEIZE_LEAD_NANOSECONDS;
+            }
+
+            /* Detached processes of others cannot be waited for. */
+
+            if (
+                !process->spawned
+                && kill(process->pid, 0) == -1
+                && errno == ESRCH
+            ) {
+                process->exited = 1;
+                break;
+            }
+        }
+
+        timeout.tv_sec = 0;
+        timeout.tv_nsec = (long) wait_time;
+
+        if (sigtimedwait(&signals, NULL, &timeout) == -1) {
+            vibexec_player_update(&scheduler->player);
+        }
+    }
+
+    sigprocmask(SIG_SETMASK, &previous_signals, NULL);
+    return 0;
+}
+
+static struct vibexec_process_thread *_add_thread(
+    struct vibexec_process *process,
+    pid_t pid
+) {
+    struct vibexec_process_thread *thread;
+
+    if (process->thread_count == process->thread_capacity) {
+        unsigned long new_capacity;
+        struct vibexec_process_thread *new_threads;
+
+        new_capacity = process->thread_capacity
+            ? process->thread_capacity << 1
+            : 4;
+
+        new_threads = realloc(
+            process->threads,
+            sizeof(struct vibexec_process_thread) * new_capacity
+        );
+
+        if (!new_threads) {
+            fputs("Cannot allocate memory.\n", stderr);
+            return NULL;
+        }
+
+        process->threads = new_threads;
+        process->thread_capacity = new_capacity;
+    }
+
+    thread = &process->threads[process->thread_count++];
+    thread->tracee.pid = pid;
+    thread->tracee.pending_signal = 0;
+    thread->fresh = 0;
+    thread->paused = 0;
+
+    vibexec_governor_initialize(
+        &thread->tracee.governor,
+        process->slowdown_budget
+    );
+
+    return thread;
+}
+
+static struct vibexec_process_thread *_find_thread(
+    struct vibexec_process *process,
+    pid_t pid
+) {
+    unsigned long i;
+
+    for (i = 0; i < process->thread_count; i++) {
+        if (process->threads[i].tracee.pid == pid) {
+            return &process->threads[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void _handle_stop(void *context, pid_t pid, int status) {
+    struct vibexec_process *process;
+    struct vibexec_scheduler *scheduler;
+    struct vibexec_process_thread *thread;
+    struct timespec pause;
+    int event;
+
+    process = context;
+    scheduler = process->scheduler;
+    thread = _find_thread(process, pid);
+
+    if (!thread) {
+        /* The child terminated while being detached. */
+
+        if (pid == process->pid && !WIFSTOPPED(status)) {
+            process->exited = 1;
+            return;
+        }
+
+        /* A new thread may stop before its creator reports it. */
+
+        if (!WIFSTOPPED(status) || !(thread = _add_thread(process, pid))) {
+            return;
+        }
+
+        thread->fresh = 1;
+    }
+
+    event = WIFSTOPPED(status) ? status >> 16 : 0;
+
+    /* Track new threads, which are traced automatically. */
+
+    if (event == PTRACE_EVENT_CLONE) {
+        unsigned long new_pid;
+
+        if (
+            ptrace(PTRACE_GETEVENTMSG, pid, NULL, &new_pid) != -1
+            && !_find_thread(process, (pid_t) new_pid)
+            && _add_thread(process, (pid_t) new_pid)
+        ) {
+            process->threads[process->thread_count - 1].fresh = 1;
+        }
+
+        /* Adding may have moved the thread. */
+
+        thread = _find_thread(process, pid);
+        vibexec_tracee_resume(&thread->tracee);
+        return;
+    }
+
+    /* Auto-attached threads start with SIGSTOP or an event stop. */
+
+    if (thread->fresh && WIFSTOPPED(status)) {
+        thread->fresh = 0;
+
+        if (WSTOPSIG(status) == SIGSTOP || event == PTRACE_EVENT_STOP) {
+            vibexec_tracee_resume(&thread->tracee);
+            return;
+        }
+    }
+
+    if (vibexec_tracee_handle_status(&thread->tracee, status)) {
+        _remove_thread(process, thread);
+        return;
+    }
+
+    /*
+     * Group stops last until the process is continued. Other events, like
+     * the stop after seizing, are no system calls to pause at.
+     */
+
+    if (event == PTRACE_EVENT_STOP && WSTOPSIG(status) != SIGTRAP) {
+        ptrace(PTRACE_LISTEN, pid, NULL, NULL);
+        return;
+    }
+
+    if (event) {
+        vibexec_tracee_resume(&thread->tracee);
+        return;
+    }
+
+    /* Release the thread, if the vibe stays calm for a while. */
+
+    if (
+        process->quiet_threshold > 0.0
+        && vibexec_scheduler_quiet_span(
+            scheduler,
+            process->quiet_threshold,
+            QUIET_MINIMUM_NANOSECONDS
+        ) >= QUIET_MINIMUM_NANOSECONDS
+    ) {
+        if (!vibexec_tracee_detach(&thread->tracee)) {
+            _remove_thread(process, thread);
+            process->quiet = 1;
+            return;
+        }
+    }
+
+    vibexec_tracee_pause(&thread->tracee, scheduler, &pause);
+
+    /* The virtual clock skips the pause right away. */
+
+    if (scheduler->virtual_clock) {
+        vibexec_scheduler_wait(scheduler, &pause);
+        pause.tv_sec = 0;
+        pause.tv_nsec = 0;
+    }
+
+    /*
+     * Pause the thread by delaying its resumption, such that other threads
+     * keep running meanwhile. Even without pause, it is only resumed once all
+     * pending stops are collected: waitpid reports threads in a fixed order,
+     * and a thread that stops again right away would starve those behind it.
+     */
+
+    clock_gettime(CLOCK_MONOTONIC, &thread->resume_time);
+    thread->resume_time.tv_sec += pause.tv_sec;
+    thread->resume_time.tv_nsec += pause.tv_nsec;
+
+    if (thread->resume_time.tv_nsec >= 1000000000) {
+        thread->resume_time.tv_nsec -= 1000000000;
+        thread->resume_time.tv_sec++;
+    }
+
+    thread->paused = 1;
+}
+
+static void _remove_thread(
+    struct vibexec_process *process,
+    struct vibexec_process_thread *thread
+) {
+    *thread = process->threads[--process->thread_count];
+}
+
+static double _resume_due_threads(struct vibexec_process *process) {
+    struct timespec current_time;
+    double next_deadline;
+    unsigned long i;
+
+    clock_gettime(CLOCK_MONOTONIC, &current_time);
+    next_deadline = VIBEXEC_PLAYER_INTERVAL_NANOSECONDS;
+
+    /* Returns the nanoseconds until the next pause ends. */
+
+    for (i = 0; i < process->thread_count; i++) {
+        struct vibexec_process_thread *thread;
+        double remaining;
+
+        thread = &process->threads[i];
+
+        if (!thread->paused) {
+            continue;
+        }
+
+        remaining =
+            (thread->resume_time.tv_sec - current_time.tv_sec) * 1000000000.0
+            + (thread->resume_time.tv_nsec - current_time.tv_nsec);
+
+        if (remaining <= 0.0) {
+            thread->paused = 0;
+            vibexec_tracee_resume(&thread->tracee);
+            continue;
+        }
+
+        if (remaining < next_deadline) {
+            next_deadline = remaining;
+        }
+    }
+
+    return next_deadline;
+}
+
+static void _seize(struct vibexec_process *process) {
+    char path[64];
+    int seized;
+
+    snprintf(path, sizeof(path), "/proc/%ld/task", (long) process->pid);
+
+    /*
+     * Threads that are created meanwhile by untraced threads only show up in
+     * the next pass, hence repeat until nothing changes.
+     */
+
+    do {
+        struct dirent *entry;
+        DIR *tasks;
+
+        seized = 0;
+        tasks = opendir(path);
+
+        if (!tasks) {
+            break;
+        }
+
+        while ((entry = readdir(tasks))) {
+            struct vibexec_process_thread *thread;
+            pid_t pid;
+
+            pid = (pid_t) strtol(entry->d_name, NULL, 10);
+
+            if (pid <= 0 || _find_thread(process, pid)) {
+                continue;
+            }
+
+            thread = _add_thread(process, pid);
+
+            if (!thread) {
+                break;
+            }
+
+            if (vibexec_tracee_seize(&thread->tracee, pid)) {
+                _remove_thread(process, thread);
+                continue;
+            }
+
+            seized = 1;
+        }
+
+        closedir(tasks);
+    } while (seized);
+
+    process->quiet = 0;
+
+    if (!process->thread_count) {
+        process->exited = 1;
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef _VIBEXEC_PROCESS_H_
+#define _VIBEXEC_PROCESS_H_
+
+#include <time.h>
+#include <sys/types.h>
+#include "scheduler.h"
+#include "tracee.h"
+
+/*
+ * Traces all threads of a program, which is either launched or seized while
+ * running.
+ *
+ * With a quiet threshold, threads are detached at their next stop while the
+ * upcoming scores stay at or above the threshold, and the whole process is
+ * seized again shortly before the first lower score. Hence, the calm parts of
+ * the vibe do not cost any tracing overhead.
+ */
+
+struct vibexec_process_thread {
+    struct vibexec_tracee tracee;
+
+    /* Attached automatically, the first stop only reports the attachment. */
+
+    int fresh;
+
+    /* Pauses run concurrently, each until its deadline on CLOCK_MONOTONIC. */
+
+    int paused;
+    struct timespec resume_time;
+};
+
+struct vibexec_process {
+    pid_t pid;
+    int spawned;
+    double slowdown_budget;
+
+    /* Score, at or above which the process is detached. Zero disables. */
+
+    double quiet_threshold;
+
+    /* Threads that are traced currently. */
+
+    struct vibexec_process_thread *threads;
+    unsigned long thread_count;
+    unsigned long thread_capacity;
+
+    /* Scheduler of the current run. */
+
+    struct vibexec_scheduler *scheduler;
+
+    /* Set while threads are detached for a quiet span. */
+
+    int quiet;
+    int exited;
+};
+
+void vibexec_process_cleanup(struct vibexec_process *process);
+void vibexec_process_initialize(
+    struct vibexec_process *process,
+    double slowdown_budget,
+    double quiet_threshold
+);
+
+/* Seizes all threads of the running process pid. */
+int vibexec_process_attach(struct vibexec_process *process, pid_t pid);
+
+/* Launches the program as traced child. */
+int vibexec_process_spawn(
+    struct vibexec_process *process,
+    char *const program[]
+);
+
+/* Traces the process until it terminated. */
+int vibexec_process_run(
+    struct vibexec_process *process,
+    struct vibexec_scheduler *scheduler
+);
+
+#endif
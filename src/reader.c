@@ -0,0 +1,455 @@
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "reader.h"
+
+static void _submit(struct vibexec_reader *reader, unsigned int slot);
+static int _wait(struct vibexec_reader *reader, unsigned int slot);
+static void *_run_worker(void *argument);
+
+#ifdef VIBEXEC_HAVE_IO_URING
+static void _cleanup_io_uring(struct vibexec_reader *reader);
+static int _initialize_io_uring(struct vibexec_reader *reader);
+static void _submit_io_uring(
+    struct vibexec_reader *reader,
+    unsigned int slot
+);
+
+static int _wait_io_uring(struct vibexec_reader *reader, unsigned int slot);
+#endif
+
+void vibexec_reader_cleanup(struct vibexec_reader *reader) {
+    switch (reader->backend) {
+#ifdef VIBEXEC_HAVE_IO_URING
+        case READER_IO_URING:
+            _cleanup_io_uring(reader);
+            break;
+#endif
+
+        case READER_THREAD:
+        default:
+            pthread_mutex_lock(&reader->worker.lock);
+            reader->worker.stopping = 1;
+            pthread_cond_broadcast(&reader->worker.changed);
+            pthread_mutex_unlock(&reader->worker.lock);
+
+            pthread_join(reader->worker.thread, NULL);
+            pthread_cond_destroy(&reader->worker.changed);
+            pthread_mutex_destroy(&reader->worker.lock);
+            break;
+    }
+
+    free(reader->slots);
+    free(reader->memory);
+}
+
+int vibexec_reader_initialize(
+    struct vibexec_reader *reader,
+    int descriptor,
+    unsigned long chunk_size,
+    unsigned int depth
+) {
+    sigset_t signals, previous_signals;
+    unsigned int i;
+    int failure;
+
+    if (!depth) {
+        fputs("Reader needs at least one chunk.\n", stderr);
+        goto error_return;
+    }
+
+    reader->descriptor = descriptor;
+    reader->chunk_size = chunk_size;
+    reader->depth = depth;
+    reader->cache.next_offset = 0;
+    reader->cache.next_slot = 0;
+    reader->cache.held_slot = -1;
+    reader->cache.failed = 0;
+
+    /* Streams can only be read in order, without offsets. */
+
+    reader->seekable = lseek(descriptor, 0, SEEK_CUR) != -1;
+
+    reader->memory = malloc(chunk_size * depth);
+
+    if (!reader->memory) {
+        fputs("Cannot allocate memory.\n", stderr);
+        goto error_return;
+    }
+
+    reader->slots = calloc(depth, sizeof(struct vibexec_reader_slot));
+
+    if (!reader->slots) {
+        fputs("Cannot allocate memory.\n", stderr);
+        goto error_cleanup_memory;
+    }
+
+    /* Prefer io_uring, but fall back to a thread, if not supported. */
+
+#ifdef VIBEXEC_HAVE_IO_URING
+    if (reader->seekable && !_initialize_io_uring(reader)) {
+        reader->backend = READER_IO_URING;
+        goto submit;
+    }
+#endif
+
+    reader->backend = READER_THREAD;
+    reader->worker.next_slot = 0;
+    reader->worker.stopping = 0;
+
+    for (i = 0; i < depth; i++) {
+        reader->slots[i].state = SLOT_READY;
+    }
+
+    if (pthread_mutex_init(&reader->worker.lock, NULL)) {
+        fputs("Cannot create reader lock.\n", stderr);
+        goto error_cleanup_slots;
+    }
+
+    if (pthread_cond_init(&reader->worker.changed, NULL)) {
+        fputs("Cannot create reader condition.\n", stderr);
+        goto error_cleanup_lock;
+    }
+
+    /*
+     * The thread inherits a mask that blocks all signals, which leaves them
+     * to the threads that wait for them, e.g. through signalfd.
+     */
+
+    sigfillset(&signals);
+    pthread_sigmask(SIG_SETMASK, &signals, &previous_signals);
+
+    failure = pthread_create(
+        &reader->worker.thread,
+        NULL,
+        _run_worker,
+        reader
+    );
+
+    pthread_sigmask(SIG_SETMASK, &previous_signals, NULL);
+
+    if (failure) {
+        fputs("Cannot start reader thread.\n", stderr);
+        goto error_cleanup_condition;
+    }
+
+#ifdef VIBEXEC_HAVE_IO_URING
+submit:
+#endif
+
+    /* Read ahead. */
+
+    for (i = 0; i < depth; i++) {
+        _submit(reader, i);
+    }
+
+    return 0;
+
+error_cleanup_condition:
+    pthread_cond_destroy(&reader->worker.changed);
+error_cleanup_lock:
+    pthread_mutex_destroy(&reader->worker.lock);
+error_cleanup_slots:
+    free(reader->slots);
+error_cleanup_memory:
+    free(reader->memory);
+error_return:
+    return -1;
+}
+
+int vibexec_reader_next(
+    struct vibexec_reader *reader,
+    const void **buffer,
+    unsigned long *buffer_size
+) {
+    struct vibexec_reader_slot *slot;
+    unsigned int slot_index;
+
+    if (reader->cache.failed) {
+        return -1;
+    }
+
+    /* Recycle the chunk that the caller is done with. */
+
+    if (reader->cache.held_slot != -1) {
+        _submit(reader, (unsigned int) reader->cache.held_slot);
+        reader->cache.held_slot = -1;
+    }
+
+    slot_index = reader->cache.next_slot;
+    slot = &reader->slots[slot_index];
+
+    /* Failures are reported once, but stick like the end of the file. */
+
+    if (_wait(reader, slot_index)) {
+        fputs("Reading failed.\n", stderr);
+        reader->cache.failed = 1;
+        return -1;
+    }
+
+    /* An empty chunk marks the end of the file: keep reporting it. */
+
+    if (!slot->filled) {
+        return 1;
+    }
+
+    reader->cache.held_slot = (int) slot_index;
+    reader->cache.next_slot = (slot_index + 1) % reader->depth;
+
+    *buffer = reader->memory + slot_index * reader->chunk_size;
+    *buffer_size = slot->filled;
+
+    return 0;
+}
+
+static void _submit(struct vibexec_reader *reader, unsigned int slot) {
+    reader->slots[slot].offset = reader->cache.next_offset;
+    reader->slots[slot].filled = 0;
+    reader->slots[slot].failed = 0;
+    reader->cache.next_offset += reader->chunk_size;
+
+    switch (reader->backend) {
+#ifdef VIBEXEC_HAVE_IO_URING
+        case READER_IO_URING:
+            reader->slots[slot].state = SLOT_PENDING;
+            _submit_io_uring(reader, slot);
+            break;
+#endif
+
+        case READER_THREAD:
+        default:
+            pthread_mutex_lock(&reader->worker.lock);
+            reader->slots[slot].state = SLOT_PENDING;
+            pthread_cond_broadcast(&reader->worker.changed);
+            pthread_mutex_unlock(&reader->worker.lock);
+            break;
+    }
+}
+
+static int _wait(struct vibexec_reader *reader, unsigned int slot) {
+    int failed;
+
+    switch (reader->backend) {
+#ifdef VIBEXEC_HAVE_IO_URING
+        case READER_IO_URING:
+            return _wait_io_uring(reader, slot);
+#endif
+
+        case READER_THREAD:
+        default:
+            pthread_mutex_lock(&reader->worker.lock);
+
+            while (reader->slots[slot].state == SLOT_PENDING) {
+                pthread_cond_wait(
+                    &reader->worker.changed,
+                    &reader->worker.lock
+                );
+            }
+
+            failed = reader->slots[slot].failed;
+            pthread_mutex_unlock(&reader->worker.lock);
+
+            return failed;
+    }
+}
+
+static void *_run_worker(void *argument) {
+    struct vibexec_reader *reader;
+
+    reader = argument;
+
+    /* Chunks are requested in slot order, hence they are read in it, too. */
+
+    pthread_mutex_lock(&reader->worker.lock);
+
+    for (;;) {
+        struct vibexec_reader_slot *slot;
+        unsigned char *target;
+        unsigned long filled;
+        int failed;
+
+        slot = &reader->slots[reader->worker.next_slot];
+
+        while (!reader->worker.stopping && slot->state != SLOT_PENDING) {
+            pthread_cond_wait(&reader->worker.changed, &reader->worker.lock);
+        }
+
+        if (reader->worker.stopping) {
+            break;
+        }
+
+        target =
+            reader->memory + reader->worker.next_slot * reader->chunk_size;
+        pthread_mutex_unlock(&reader->worker.lock);
+
+        /* Read the complete chunk, unless the file ends. */
+
+        for (filled = 0, failed = 0; filled < reader->chunk_size;) {
+            ssize_t status;
+
+            if (reader->seekable) {
+                status = pread(
+                    reader->descriptor,
+                    target + filled,
+                    reader->chunk_size - filled,
+                    (off_t) (slot->offset + filled)
+                );
+            } else {
+                status = read(
+                    reader->descriptor,
+                    target + filled,
+                    reader->chunk_size - filled
+                );
+            }
+
+            if (status < 0) {
+                failed = 1;
+                break;
+            }
+
+            if (!status) {
+                break;
+            }
+
+            filled += (unsigned long) status;
+        }
+
+        pthread_mutex_lock(&reader->worker.lock);
+
+        slot->filled = filled;
+        slot->failed = failed;
+        slot->state = SLOT_READY;
+        reader->worker.next_slot =
+            (reader->worker.next_slot + 1) % reader->depth;
+
+        pthread_cond_broadcast(&reader->worker.changed);
+    }
+
+    pthread_mutex_unlock(&reader->worker.lock);
+    return NULL;
+}
+
+#ifdef VIBEXEC_HAVE_IO_URING
+static void _cleanup_io_uring(struct vibexec_reader *reader) {
+    unsigned int i;
+
+    /* Do not release buffers that are still written by the kernel. */
+
+    for (i = 0; i < reader->depth; i++) {
+        if (reader->slots[i].state == SLOT_PENDING) {
+            _wait_io_uring(reader, i);
+        }
+    }
+
+    io_uring_queue_exit(&reader->ring);
+}
+
+static int _initialize_io_uring(struct vibexec_reader *reader) {
+    struct iovec *buffers;
+    unsigned int i;
+    int failure;
+
+    if (io_uring_queue_init(reader->depth, &reader->ring, 0)) {
+        return -1;
+    }
+
+    /* Register the chunk memory once, to save the mapping per read. */
+
+    buffers = malloc(sizeof(struct iovec) * reader->depth);
+
+    if (!buffers) {
+        io_uring_queue_exit(&reader->ring);
+        return -1;
+    }
+
+    for (i = 0; i < reader->depth; i++) {
+        buffers[i].iov_base = reader->memory + i * reader->chunk_size;
+        buffers[i].iov_len = reader->chunk_size;
+    }
+
+    failure = io_uring_register_buffers(&reader->ring, buffers, reader->depth);
+    free(buffers);
+
+    if (failure) {
+        io_uring_queue_exit(&reader->ring);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void _submit_io_uring(
+    struct vibexec_reader *reader,
+    unsigned int slot
+) {
+    struct vibexec_reader_slot *state;
+    struct io_uring_sqe *entry;
+
+    state = &reader->slots[slot];
+    entry = io_uring_get_sqe(&reader->ring);
+
+    if (!entry) {
+        /* Cannot happen, since there is at most one read per slot. */
+
+        state->failed = 1;
+        state->state = SLOT_READY;
+        return;
+    }
+
+    /* Continue partially completed reads where they stopped. */
+
+    io_uring_prep_read_fixed(
+        entry,
+        reader->descriptor,
+        reader->memory + slot * reader->chunk_size + state->filled,
+        (unsigned int) (reader->chunk_size - state->filled),
+        state->offset + state->filled,
+        (int) slot
+    );
+
+    io_uring_sqe_set_data(entry, (void *) (uintptr_t) slot);
+    io_uring_submit(&reader->ring);
+}
+
+static int _wait_io_uring(struct vibexec_reader *reader, unsigned int slot) {
+    while (reader->slots[slot].state == SLOT_PENDING) {
+        struct vibexec_reader_slot *completed;
+        struct io_uring_cqe *completion;
+        unsigned int completed_slot;
+
+        if (io_uring_wait_cqe(&reader->ring, &completion)) {
+            fputs("Waiting for read failed.\n", stderr);
+            return -1;
+        }
+
+        completed_slot = (unsigned int) (uintptr_t)
+            io_uring_cqe_get_data(completion);
+
+        completed = &reader->slots[completed_slot];
+
+        if (completion->res < 0) {
+            completed->failed = 1;
+            completed->state = SLOT_READY;
+        } else if (
+            completion->res > 0 &&
+            completed->filled + completion->res < reader->chunk_size
+        ) {
+            completed->filled += (unsigned long) completion->res;
+            _submit_io_uring(reader, completed_slot);
+        } else {
+            completed->filled += (unsigned long) completion->res;
+            completed->state = SLOT_READY;
+        }
+
+        io_uring_cqe_seen(&reader->ring, completion);
+    }
+
+    return reader->slots[slot].failed;
+}
+#endif
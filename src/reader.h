@@ -0,0 +1,82 @@
+#ifndef _VIBEXEC_READER_H_
+#define _VIBEXEC_READER_H_
+
+#include <pthread.h>
+
+#ifdef VIBEXEC_HAVE_IO_URING
+#include <liburing.h>
+#endif
+
+/*
+ * Reads a file sequentially in chunks, keeping up to depth chunks in flight
+ * ahead of consumption. Reads are issued through io_uring into pre-registered
+ * buffers, if available, otherwise by a background thread. Streams that
+ * cannot seek, like FIFOs, are always read by the thread, in order.
+ */
+
+struct vibexec_reader_slot {
+    enum {
+        SLOT_PENDING,
+        SLOT_READY
+    } state;
+
+    unsigned long offset;
+    unsigned long filled;
+    int failed;
+};
+
+struct vibexec_reader {
+    int descriptor;
+    int seekable;
+    unsigned long chunk_size;
+    unsigned int depth;
+
+    enum {
+        READER_IO_URING,
+        READER_THREAD
+    } backend;
+
+    unsigned char *memory;
+    struct vibexec_reader_slot *slots;
+
+    struct {
+        unsigned long next_offset;
+        unsigned int next_slot;
+        int held_slot;
+        int failed;
+    } cache;
+
+#ifdef VIBEXEC_HAVE_IO_URING
+    struct io_uring ring;
+#endif
+
+    /* Thread-based fallback. */
+
+    struct {
+        pthread_t thread;
+        pthread_mutex_t lock;
+        pthread_cond_t changed;
+        unsigned int next_slot;
+        int stopping;
+    } worker;
+};
+
+void vibexec_reader_cleanup(struct vibexec_reader *reader);
+int vibexec_reader_initialize(
+    struct vibexec_reader *reader,
+    int descriptor,
+    unsigned long chunk_size,
+    unsigned int depth
+);
+
+/*
+ * Returns the next chunk, which stays valid until the following call. Returns
+ * 1 at the end of the file and -1, once reading failed.
+ */
+int vibexec_reader_next(
+    struct vibexec_reader *reader,
+    const void **buffer,
+    unsigned long *buffer_size
+);
+
+#endif
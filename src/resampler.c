@@ -0,0 +1,298 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "resampler.h"
+
+/* Zero crossings of the sinc on each side of the filter center. */
+#define ZERO_CROSSINGS 8
+
+/* Cutoff relative to the lower of both Nyquist frequencies. */
+#define ROLLOFF 0.9
+
+static inline float _dot(
+    const float *restrict coefficients,
+    const float *restrict samples,
+    unsigned long length
+);
+
+static unsigned long _gcd(unsigned long a, unsigned long b);
+
+void vibexec_resampler_cleanup(struct vibexec_resampler *resampler) {
+    free(resampler->coefficients);
+    free(resampler->cache.work);
+}
+
+int vibexec_resampler_initialize(
+    struct vibexec_resampler *resampler,
+    unsigned int channels,
+    unsigned long input_frequency,
+    unsigned long output_frequency
+) {
+    unsigned long divisor, phase, tap, tap_count, widest;
+    double cutoff, center, sum;
+    double *prototype;
+
+    if (!channels || !input_frequency || !output_frequency) {
+        fputs("Invalid resampling parameters.\n", stderr);
+        goto error_return;
+    }
+
+    divisor = _gcd(input_frequency, output_frequency);
+
+    resampler->channels = channels;
+    resampler->interpolation = output_frequency / divisor;
+    resampler->decimation = input_frequency / divisor;
+
+    widest = resampler->interpolation > resampler->decimation
+        ? resampler->interpolation
+        : resampler->decimation;
+
+    /* Taps per phase, padded for the vectorized dot product. */
+
+    resampler->taps_per_phase =
+        (2 * ZERO_CROSSINGS * widest + resampler->interpolation - 1)
+        / resampler->interpolation;
+
+    resampler->taps_per_phase = (resampler->taps_per_phase + 7) & ~7UL;
+    tap_count = resampler->taps_per_phase * resampler->interpolation;
+
+    /* Design the prototype low-pass at the interpolated rate. */
+
+    prototype = malloc(sizeof(double) * tap_count);
+
+    if (!prototype) {
+        fputs("Cannot allocate memory.\n", stderr);
+        goto error_return;
+    }
+
+    cutoff = 0.5 * ROLLOFF / widest;
+    center = (tap_count - 1) / 2.0;
+    sum = 0.0;
+
+    for (tap = 0; tap < tap_count; tap++) {
+        double x, window;
+
+        x = 2.0 * cutoff * (tap - center);
+        window =
+            0.42
+            - 0.5 * cos(2.0 * M_PI * tap / (tap_count - 1))
+            + 0.08 * cos(4.0 * M_PI * tap / (tap_count - 1));
+
+        prototype[tap] =
+            window * (x == 0.0 ? 1.0 : sin(M_PI * x) / (M_PI * x));
+        sum += prototype[tap];
+    }
+
+    /* Split into phases with unity gain each, reversed for the dot product. */
+
+    resampler->coefficients = malloc(sizeof(float) * tap_count);
+
+    if (!resampler->coefficients) {
+        fputs("Cannot allocate memory.\n", stderr);
+        goto error_cleanup_prototype;
+    }
+
+    for (phase = 0; phase < resampler->interpolation; phase++) {
+        for (tap = 0; tap < resampler->taps_per_phase; tap++) {
+            resampler->coefficients[
+                phase * resampler->taps_per_phase
+                + resampler->taps_per_phase - 1 - tap
+            ] = (float) (
+                prototype[phase + tap * resampler->interpolation]
+                * resampler->interpolation / sum
+            );
+        }
+    }
+
+    free(prototype);
+
+    /* Start with silent history. */
+
+    resampler->cache.work_capacity = 0;
+    resampler->cache.work = calloc(
+        channels * (resampler->taps_per_phase - 1),
+        sizeof(float)
+    );
+
+    if (!resampler->cache.work) {
+        fputs("Cannot allocate memory.\n", stderr);
+        goto error_cleanup_coefficients;
+    }
+
+    /* Skip the group delay, which centers the first output on input 0. */
+
+    resampler->delay = (tap_count - 1) / 2 / resampler->interpolation;
+    resampler->cache.position =
+        resampler->taps_per_phase - 1 + resampler->delay;
+    resampler->cache.phase = 0;
+
+    return 0;
+
+error_cleanup_coefficients:
+    free(resampler->coefficients);
+    goto error_return;
+error_cleanup_prototype:
+    free(prototype);
+error_return:
+    return -1;
+}
+
+unsigned long vibexec_resampler_output_frames(
+    const struct vibexec_resampler *resampler,
+    unsigned long input_frames
+) {
+    return
+        (input_frames * resampler->interpolation + resampler->decimation - 1)
+        / resampler->decimation
+        + 1;
+}
+
+long vibexec_resampler_process(
+    struct vibexec_resampler *resampler,
+    const float *input,
+    unsigned long input_frames,
+    float *output
+) {
+    unsigned long history, stride, frame, output_frames;
+    unsigned int channel;
+
+    history = resampler->taps_per_phase - 1;
+
+    /* Grow the work buffer, keeping the history of each channel. */
+
+    if (input_frames > resampler->cache.work_capacity) {
+        unsigned long old_stride;
+        float *work;
+
+        work = malloc(
+            sizeof(float) * resampler->channels * (history + input_frames)
+        );
+
+        if (!work) {
+            fputs("Cannot allocate memory.\n", stderr);
+            return -1;
+        }
+
+        old_stride = history + resampler->cache.work_capacity;
+
+        for (channel = 0; channel < resampler->channels; channel++) {
+            memcpy(
+                work + channel * (history + input_frames),
+                resampler->cache.work + channel * old_stride,
+                sizeof(float) * history
+            );
+        }
+
+        free(resampler->cache.work);
+        resampler->cache.work = work;
+        resampler->cache.work_capacity = input_frames;
+    }
+
+    stride = history + resampler->cache.work_capacity;
+
+    /* Deinterleave behind the history. */
+
+    for (frame = 0; frame < input_frames; frame++) {
+        for (channel = 0; channel < resampler->channels; channel++) {
+            resampler->cache.work[channel * stride + history + frame] =
+                input[frame * resampler->channels + channel];
+        }
+    }
+
+    /* Evaluate one filter phase per output frame. */
+
+    for (
+        output_frames = 0;
+        resampler->cache.position < history + input_frames;
+        output_frames++
+    ) {
+        const float *coefficients;
+
+        coefficients =
+            resampler->coefficients
+            + resampler->cache.phase * resampler->taps_per_phase;
+
+        for (channel = 0; channel < resampler->channels; channel++) {
+            output[output_frames * resampler->channels + channel] = _dot(
+                coefficients,
+                resampler->cache.work
+                    + channel * stride
+                    + resampler->cache.position - history,
+                resampler->taps_per_phase
+            );
+        }
+
+        resampler->cache.phase += resampler->decimation;
+        resampler->cache.position +=
+            resampler->cache.phase / resampler->interpolation;
+        resampler->cache.phase %= resampler->interpolation;
+    }
+
+    /* Keep the tail as history of the next block. */
+
+    resampler->cache.position -= input_frames;
+
+    for (channel = 0; channel < resampler->channels; channel++) {
+        memmove(
+            resampler->cache.work + channel * stride,
+            resampler->cache.work + channel * stride + input_frames,
+            sizeof(float) * history
+        );
+    }
+
+    return (long) output_frames;
+}
+
+static inline float _dot(
+    const float *restrict coefficients,
+    const float *restrict samples,
+    unsigned long length
+) {
+    unsigned long i;
+
+#if defined(__GNUC__)
+    /*
+     * The length is a multiple of eight, which allows two independent
+     * accumulators of four lanes each.
+     */
+
+    typedef float v4sf __attribute__((vector_size(16)));
+    v4sf sum_low = { 0.0F }, sum_high = { 0.0F };
+
+    for (i = 0; i < length; i += 8) {
+        v4sf c_low, c_high, s_low, s_high;
+
+        memcpy(&c_low, coefficients + i, sizeof(v4sf));
+        memcpy(&c_high, coefficients + i + 4, sizeof(v4sf));
+        memcpy(&s_low, samples + i, sizeof(v4sf));
+        memcpy(&s_high, samples + i + 4, sizeof(v4sf));
+
+        sum_low += c_low * s_low;
+        sum_high += c_high * s_high;
+    }
+
+    sum_low += sum_high;
+    return sum_low[0] + sum_low[1] + sum_low[2] + sum_low[3];
+#else
+    float sum = 0.0F;
+
+    for (i = 0; i < length; i++) {
+        sum += coefficients[i] * samples[i];
+    }
+
+    return sum;
+#endif
+}
+
+static unsigned long _gcd(unsigned long a, unsigned long b) {
+    while (b) {
+        unsigned long remainder = a % b;
+
+        a = b;
+        b = remainder;
+    }
+
+    return a;
+}
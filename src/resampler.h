@@ -0,0 +1,63 @@
+#ifndef _VIBEXEC_RESAMPLER_H_
+#define _VIBEXEC_RESAMPLER_H_
+
+/*
+ * Rational polyphase resampler for interleaved float samples.
+ *
+ * The rate is changed by interpolating by L and decimating by M, where L/M is
+ * the reduced ratio of output to input frequency. A windowed-sinc low-pass
+ * with cutoff below both Nyquist frequencies prevents aliasing. Only the
+ * filter phase needed for each output sample is evaluated.
+ *
+ * The group delay of the filter is compensated, i.e. output frames are
+ * centered on their input frames. Therefore, the last delay input frames
+ * only contribute to the output once more input follows.
+ */
+struct vibexec_resampler {
+    unsigned int channels;
+    unsigned long interpolation;
+    unsigned long decimation;
+    unsigned long taps_per_phase;
+    unsigned long delay;
+
+    /* Per phase, reversed and zero-padded to a multiple of eight. */
+
+    float *coefficients;
+
+    struct {
+        /* Per channel: taps_per_phase - 1 samples history + input block. */
+
+        float *work;
+        unsigned long work_capacity;
+
+        unsigned long position;
+        unsigned long phase;
+    } cache;
+};
+
+void vibexec_resampler_cleanup(struct vibexec_resampler *resampler);
+int vibexec_resampler_initialize(
+    struct vibexec_resampler *resampler,
+    unsigned int channels,
+    unsigned long input_frequency,
+    unsigned long output_frequency
+);
+
+/* Upper bound of output frames for the given number of input frames. */
+unsigned long vibexec_resampler_output_frames(
+    const struct vibexec_resampler *resampler,
+    unsigned long input_frames
+);
+
+/*
+ * Resamples the input and returns the number of frames written to output,
+ * which must provide room for vibexec_resampler_output_frames frames.
+ */
+long vibexec_resampler_process(
+    struct vibexec_resampler *resampler,
+    const float *input,
+    unsigned long input_frames,
+    float *output
+);
+
+#endif
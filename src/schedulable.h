@@ -0,0 +1,18 @@
+#ifndef _VIBEXEC_SCHEDULABLE_H_
+#define _VIBEXEC_SCHEDULABLE_H_
+
+/*
+ * Format of a vibe. Kept apart from the scheduler, such that the analysis
+ * builds without the player and its audio library.
+ */
+struct vibexec_schedulable_parameters {
+    unsigned int channels;
+    unsigned long sample_frequency;
+
+    enum {
+        SIGNED_8BIT,
+        SIGNED_16BIT
+    } sample_format;
+};
+
+#endif
@@ -4,55 +4,54 @@
 #include <time.h>
 
 #include "player.h"
+#include "preanalyzer.h"
+#include "reader.h"
 #include "scheduler.h"
+#include "timeline.h"
 #include "vibeomatic.h"
 
-static struct {
-    /* General.*/
-
-    int initialized;
-
-    /* Vibe-specific information. */
-
-    struct vibexec_schedulable_parameters parameters;
-    FILE *source;
-    struct vibexec_vibeomatic_session session;
-    struct timespec start;
-    int started;
-
-    struct {
-        unsigned long buffer_size;
-        void *buffer;
-    } cache;
-} _vibe;
-
-void vibexec_scheduler_cleanup(void) {
-    if (!_vibe.initialized) {
+void vibexec_scheduler_cleanup(struct vibexec_scheduler *scheduler) {
+    if (!scheduler->initialized) {
         fputs("Vibe not initialized.\n", stderr);
         return;
     }
 
-    free(_vibe.cache.buffer);
-    vibexec_vibeomatic_cleanup(&_vibe.session);
-    fclose(_vibe.source);
-    _vibe.initialized = 0;
+    vibexec_player_cleanup(&scheduler->player);
+    vibexec_reader_cleanup(&scheduler->reader);
+
+    if (scheduler->publishing) {
+        vibexec_timeline_cleanup(&scheduler->timeline);
+    }
+
+    vibexec_vibeomatic_cleanup(&scheduler->session);
+    fclose(scheduler->source);
+    scheduler->initialized = 0;
 }
 
 int vibexec_scheduler_initialize(
+    struct vibexec_scheduler *scheduler,
     const struct vibexec_schedulable_vibe *vibe
 ) {
+    unsigned long decimation;
     int failure;
 
-    if (_vibe.initialized) {
-        fputs("Vibe already initialized.\n", stderr);
+    scheduler->initialized = 0;
+    scheduler->started = 0;
+
+    if (vibe->virtual_clock && !vibe->headless) {
+        fputs("Virtual clock requires headless playback.\n", stderr);
         goto error_return;
     }
 
+    scheduler->virtual_clock = vibe->virtual_clock;
+    scheduler->skipped.tv_sec = 0;
+    scheduler->skipped.tv_nsec = 0;
+
     /* Open source file. */
 
-    _vibe.source = fopen(vibe->path, "r");
+    scheduler->source = fopen(vibe->path, "r");
 
-    if (!_vibe.source) {
+    if (!scheduler->source) {
         fputs("Vibe not existing.\n", stderr);
         goto error_return;
     }
@@ -60,17 +59,60 @@ int vibexec_scheduler_initialize(
     /* Copy decoding settings. */
 
     memcpy(
-        &_vibe.parameters,
+        &scheduler->parameters,
         &vibe->parameters,
         sizeof(struct vibexec_schedulable_parameters)
     );
 
-    /* Create vibe-o-matic session. */
+    /*
+     * Create vibe-o-matic session. The analysis rate is rounded to an integer
+     * fraction of the sample frequency, which keeps the windows aligned with
+     * whole frames of the vibe.
+     */
+
+    decimation = 1;
+
+    if (vibe->analysis_frequency) {
+        /* Lower rates leave too few coefficients to score. */
+
+        if (
+            vibe->analysis_frequency
+                < VIBEXEC_VIBEOMATIC_MINIMUM_WINDOW_SIZE << 6
+        ) {
+            fprintf(
+                stderr,
+                "Analysis frequency too low, the minimum is %d Hz.\n",
+                VIBEXEC_VIBEOMATIC_MINIMUM_WINDOW_SIZE << 6
+            );
+
+            goto error_cleanup_source;
+        }
+
+        decimation =
+            (scheduler->parameters.sample_frequency
+                + vibe->analysis_frequency / 2)
+            / vibe->analysis_frequency;
+
+        /* Round up the rate instead, if the nearest one is too low. */
+
+        while (
+            decimation > 1
+            && ((scheduler->parameters.sample_frequency / decimation) >> 6)
+                < VIBEXEC_VIBEOMATIC_MINIMUM_WINDOW_SIZE
+        ) {
+            decimation--;
+        }
+
+        if (!decimation) {
+            decimation = 1;
+        }
+    }
 
     failure = vibexec_vibeomatic_initialize(
-        &_vibe.session,
-        &_vibe.parameters,
-        _vibe.parameters.sample_frequency >> 6
+        &scheduler->session,
+        &scheduler->parameters,
+        (scheduler->parameters.sample_frequency / decimation) >> 6,
+        decimation
     );
 
     if (failure) {
@@ -78,112 +120,257 @@ int vibexec_scheduler_initialize(
         goto error_cleanup_source;
     }
 
+    /* Analyze the whole vibe in advance, if requested. */
+
+    scheduler->preanalyzed = 0;
+
+    if (vibe->analysis_workers) {
+        failure = vibexec_preanalyzer_run(
+            &scheduler->session,
+            scheduler->source,
+            vibe->analysis_workers
+        );
+
+        if (failure < 0) {
+            fputs("Cannot pre-analyze vibe.\n", stderr);
+            goto error_cleanup_vibeomatic;
+        }
+
+        scheduler->preanalyzed = !failure;
+    }
+
+    /* Publish the score timeline, if requested. */
+
+    scheduler->publishing = 0;
+
+    if (vibe->timeline_name) {
+        failure = vibexec_timeline_initialize(
+            &scheduler->timeline,
+            vibe->timeline_name,
+            &scheduler->session
+        );
+
+        if (failure) {
+            fputs("Cannot publish score timeline.\n", stderr);
+            goto error_cleanup_vibeomatic;
+        }
+
+        scheduler->publishing = 1;
+    }
+
     /* Fill cache. */
 
-    _vibe.cache.buffer_size =
+    scheduler->cache.buffer_size =
         vibe->parameters.sample_frequency * vibe->parameters.channels;
 
-    switch (_vibe.parameters.sample_format) {
+    switch (scheduler->parameters.sample_format) {
         case SIGNED_8BIT:
             /* Nothing to do here: 8 bit = 1 byte. */
             break;
 
         case SIGNED_16BIT:
-            _vibe.cache.buffer_size <<= 1;
+            scheduler->cache.buffer_size <<= 1;
             break;
 
         default:
             fputs("Unknown vibe format.\n", stderr);
-            goto error_cleanup_vibeomatic;
+            goto error_cleanup_timeline;
     }
 
-    _vibe.cache.buffer = malloc(_vibe.cache.buffer_size);
+    /* Start reading ahead. */
 
-    if (!_vibe.cache.buffer) {
-        fputs("Buffer allocation failed.\n", stderr);
-        goto error_cleanup_source;
+    failure = vibexec_reader_initialize(
+        &scheduler->reader,
+        fileno(scheduler->source),
+        scheduler->cache.buffer_size,
+        vibe->readahead ? vibe->readahead : 1
+    );
+
+    if (failure) {
+        fputs("Cannot read vibe.\n", stderr);
+        goto error_cleanup_timeline;
+    }
+
+    /* Prepare the playback. */
+
+    failure = vibexec_player_initialize(&scheduler->player, scheduler, vibe);
+
+    if (failure) {
+        fputs("Cannot play vibe.\n", stderr);
+        goto error_cleanup_reader;
     }
 
     /* Finalize. */
 
-    _vibe.initialized = 1;
+    scheduler->initialized = 1;
     return 0;
 
+error_cleanup_reader:
+    vibexec_reader_cleanup(&scheduler->reader);
+error_cleanup_timeline:
+    if (scheduler->publishing) {
+        vibexec_timeline_cleanup(&scheduler->timeline);
+    }
 error_cleanup_vibeomatic:
-    vibexec_vibeomatic_cleanup(&_vibe.session);
+    vibexec_vibeomatic_cleanup(&scheduler->session);
 error_cleanup_source:
-    fclose(_vibe.source);
+    fclose(scheduler->source);
 error_return:
     return -1;
 }
 
-int vibexec_scheduler_next_buffer(struct vibexec_scheduled_buffer *buffer) {
+int vibexec_scheduler_next_buffer(
+    struct vibexec_scheduler *scheduler,
+    struct vibexec_scheduled_buffer *buffer
+) {
+    const void *actual_buffer;
     unsigned long actual_buffer_size;
 
-    if (!_vibe.initialized) {
+    if (!scheduler->initialized) {
         fputs("Vibe not initialized.\n", stderr);
         return -1;
     }
 
-    if (!_vibe.started) {
-        clock_gettime(CLOCK_MONOTONIC, &_vibe.start);
-        _vibe.started = 1;
+    if (!scheduler->started) {
+        clock_gettime(CLOCK_MONOTONIC, &scheduler->start);
+        scheduler->started = 1;
     }
 
     /*
-     * Fill the internal buffer, if possible.
-     *
-     * NOTE:    Cast size_t -> unsigned long is safe, because returned value is
-     *          never greater than _vibe.cache.buffer_size, which is unsigned
-     *          long.
+     * Take the next chunk that has been read ahead. This only blocks, if the
+     * storage cannot keep up with the playback.
      */
 
-    actual_buffer_size = (unsigned long) fread(
-        _vibe.cache.buffer,
-        1, _vibe.cache.buffer_size,
-        _vibe.source
-    );
-
-    if (!actual_buffer_size) {
-        /* EOF */
+    if (
+        vibexec_reader_next(
+            &scheduler->reader,
+            &actual_buffer,
+            &actual_buffer_size
+        )
+    ) {
+        /* EOF, or the vibe cannot be read, which the reader reports. */
         return -1;
     }
 
-    /* Feed the vibe-o-matic. */
+    /* Feed the vibe-o-matic, unless the scores are known already. */
 
-    vibexec_vibeomatic_analyze(
-        &_vibe.session,
-        _vibe.cache.buffer,
-        actual_buffer_size
-    );
+    if (!scheduler->preanalyzed) {
+        vibexec_vibeomatic_analyze(
+            &scheduler->session,
+            (void *) actual_buffer,
+            actual_buffer_size
+        );
+    }
+
+    /* Make the new scores visible to other processes. */
+
+    if (scheduler->publishing) {
+        struct timespec current_time, now, start;
+
+        /*
+         * Consumers only know CLOCK_MONOTONIC, so the virtual clock shifts
+         * the start by the skipped pauses.
+         */
+
+        clock_gettime(CLOCK_MONOTONIC, &current_time);
+        vibexec_scheduler_now(scheduler, &now);
+        _compute_difference(&start, &current_time, &now);
+
+        vibexec_timeline_publish(
+            &scheduler->timeline,
+            &scheduler->session,
+            &start,
+            &current_time
+        );
+    }
 
     /* Pass the internal buffer to caller. */
 
-    buffer->parameters = &_vibe.parameters;
+    buffer->parameters = &scheduler->parameters;
     buffer->buffer_size = actual_buffer_size;
-    buffer->buffer = _vibe.cache.buffer;
+    buffer->buffer = actual_buffer;
 
     return 0;
 }
 
-void vibexec_scheduler_yield_to_vibe(void) {
-    struct timespec current_time, diff_since_start;
+void vibexec_scheduler_next_pause(
+    struct vibexec_scheduler *scheduler,
+    struct timespec *pause
+) {
+    struct timespec diff_since_start;
     double score;
 
-    vibexec_player_update();
-
-    clock_gettime(CLOCK_MONOTONIC, &current_time);
-    _compute_difference(&diff_since_start, &current_time, &_vibe.start);
+    vibexec_player_update(&scheduler->player);
+    vibexec_scheduler_now(scheduler, &diff_since_start);
 
     score = vibexec_vibeomatic_drop_and_score(
-        &_vibe.session,
+        &scheduler->session,
         &diff_since_start
     );
 
-    struct timespec pause;
+    pause->tv_nsec = (long) ((1.0 - score) * 10000000);
+    pause->tv_sec = 0;
+}
+
+void vibexec_scheduler_now(
+    struct vibexec_scheduler *scheduler,
+    struct timespec *now
+) {
+    struct timespec current_time;
 
-    pause.tv_nsec = (long) ((1.0 - score) * 10000000);
-    pause.tv_sec = 0;
+    if (!scheduler->started) {
+        now->tv_sec = 0;
+        now->tv_nsec = 0;
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &current_time);
+    _compute_difference(now, &current_time, &scheduler->start);
 
-    nanosleep(&pause, NULL);
+    if (!scheduler->virtual_clock) {
+        return;
+    }
+
+    now->tv_sec += scheduler->skipped.tv_sec;
+    now->tv_nsec += scheduler->skipped.tv_nsec;
+
+    if (now->tv_nsec >= 1000000000) {
+        now->tv_nsec -= 1000000000;
+        now->tv_sec++;
+    }
+}
+
+double vibexec_scheduler_quiet_span(
+    struct vibexec_scheduler *scheduler,
+    double threshold,
+    double horizon
+) {
+    struct timespec now;
+
+    vibexec_scheduler_now(scheduler, &now);
+
+    return vibexec_vibeomatic_quiet_span(
+        &scheduler->session,
+        threshold,
+        &now,
+        horizon
+    );
+}
+
+void vibexec_scheduler_wait(
+    struct vibexec_scheduler *scheduler,
+    const struct timespec *pause
+) {
+    if (!scheduler->virtual_clock) {
+        nanosleep(pause, NULL);
+        return;
+    }
+
+    scheduler->skipped.tv_sec += pause->tv_sec;
+    scheduler->skipped.tv_nsec += pause->tv_nsec;
+
+    if (scheduler->skipped.tv_nsec >= 1000000000) {
+        scheduler->skipped.tv_nsec -= 1000000000;
+        scheduler->skipped.tv_sec++;
+    }
 }
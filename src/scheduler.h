@@ -1,19 +1,58 @@
 #ifndef _VIBEXEC_SCHEDULER_H_
 #define _VIBEXEC_SCHEDULER_H_
 
-struct vibexec_schedulable_parameters {
-    unsigned int channels;
-    unsigned long sample_frequency;
-
-    enum {
-        SIGNED_8BIT,
-        SIGNED_16BIT
-    } sample_format;
-};
+#include <stdio.h>
+#include <time.h>
+#include "player.h"
+#include "reader.h"
+#include "schedulable.h"
+#include "timeline.h"
+#include "vibeomatic.h"
 
 struct vibexec_schedulable_vibe {
     const char *path;
     struct vibexec_schedulable_parameters parameters;
+
+    /*
+     * Number of threads that analyze the whole vibe in advance. If zero, the
+     * vibe is analyzed incrementally while being played.
+     */
+
+    unsigned int analysis_workers;
+
+    /*
+     * Sample frequency at which the vibe is analyzed, rounded to an integer
+     * fraction of its actual frequency. If zero, no decimation takes place.
+     */
+
+    unsigned long analysis_frequency;
+
+    /* Number of one-second chunks that are read ahead of the playback. */
+
+    unsigned int readahead;
+
+    /*
+     * Name of the shared-memory segment that the score timeline is published
+     * to (see timeline). If NULL, the timeline stays private.
+     */
+
+    const char *timeline_name;
+
+    /*
+     * Plays the vibe on a null sink instead of the audio device, which
+     * optionally renders it into the WAV file at wav_path (may be NULL).
+     */
+
+    int headless;
+    const char *wav_path;
+
+    /*
+     * Lets the clock skip the pauses of traced programs instead of sleeping,
+     * such that the vibe advances by the injected pauses plus the time the
+     * programs run on their own. Requires headless playback.
+     */
+
+    int virtual_clock;
 };
 
 struct vibexec_scheduled_buffer {
@@ -22,9 +61,75 @@ struct vibexec_scheduled_buffer {
     const void *buffer;
 };
 
-void vibexec_scheduler_cleanup(void);
-int vibexec_scheduler_initialize(const struct vibexec_schedulable_vibe *vibe);
-int vibexec_scheduler_next_buffer(struct vibexec_scheduled_buffer *buffer);
-void vibexec_scheduler_yield_to_vibe(void);
+struct vibexec_scheduler {
+    /* General.*/
+
+    int initialized;
+
+    /* Vibe-specific information. */
+
+    struct vibexec_schedulable_parameters parameters;
+    FILE *source;
+    struct vibexec_vibeomatic_session session;
+    struct vibexec_player player;
+    struct timespec start;
+    int started;
+    int preanalyzed;
+
+    /* Pauses skipped by the virtual clock. */
+
+    int virtual_clock;
+    struct timespec skipped;
+
+    struct vibexec_reader reader;
+    struct vibexec_timeline timeline;
+    int publishing;
+
+    struct {
+        unsigned long buffer_size;
+    } cache;
+};
+
+void vibexec_scheduler_cleanup(struct vibexec_scheduler *scheduler);
+int vibexec_scheduler_initialize(
+    struct vibexec_scheduler *scheduler,
+    const struct vibexec_schedulable_vibe *vibe
+);
+
+int vibexec_scheduler_next_buffer(
+    struct vibexec_scheduler *scheduler,
+    struct vibexec_scheduled_buffer *buffer
+);
+
+/*
+ * Updates the playback and determines how long the current stop of a traced
+ * program shall last. All programs that share the scheduler share its vibe.
+ */
+void vibexec_scheduler_next_pause(
+    struct vibexec_scheduler *scheduler,
+    struct timespec *pause
+);
+
+/* Time since the start of the vibe on the clock of the scheduler. */
+void vibexec_scheduler_now(
+    struct vibexec_scheduler *scheduler,
+    struct timespec *now
+);
+
+/*
+ * Nanoseconds from now on, during which the vibe stays at or above the score
+ * threshold as far as known, but at most the horizon.
+ */
+double vibexec_scheduler_quiet_span(
+    struct vibexec_scheduler *scheduler,
+    double threshold,
+    double horizon
+);
+
+/* Waits for the pause on the clock of the scheduler. */
+void vibexec_scheduler_wait(
+    struct vibexec_scheduler *scheduler,
+    const struct timespec *pause
+);
 
 #endif
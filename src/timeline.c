@@ -0,0 +1,197 @@
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "timeline.h"
+#include "vibeomatic.h"
+
+/* Minimum span of the score ring in seconds. */
+#define RING_SECONDS 16
+
+void vibexec_timeline_cleanup(struct vibexec_timeline *timeline) {
+    munmap(timeline->segment, timeline->segment_size);
+    shm_unlink(timeline->name);
+}
+
+int vibexec_timeline_initialize(
+    struct vibexec_timeline *timeline,
+    const char *name,
+    const struct vibexec_vibeomatic_session *session
+) {
+    struct vibexec_timeline_segment *segment;
+    unsigned long capacity, windows;
+    int descriptor;
+
+    timeline->name = name;
+
+    /* Size the ring, such that it spans the read-ahead of the player. */
+
+    windows = (unsigned long)
+        (RING_SECONDS * 1000000000.0 / session->cache.nanoseconds_per_window);
+
+    for (capacity = 1; capacity < windows; capacity <<= 1);
+
+    timeline->segment_size =
+        sizeof(struct vibexec_timeline_segment)
+        + sizeof(segment->scores[0]) * capacity;
+
+    /*
+     * Create a new segment, replacing any stale one of the same name. The
+     * name is unlinked rather than the object truncated, such that consumers
+     * that still map the old object keep it intact.
+     */
+
+    shm_unlink(name);
+    descriptor = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+
+    if (descriptor == -1) {
+        fputs("Cannot create timeline segment.\n", stderr);
+        goto error_return;
+    }
+
+    if (ftruncate(descriptor, (off_t) timeline->segment_size)) {
+        fputs("Cannot resize timeline segment.\n", stderr);
+        goto error_cleanup_descriptor;
+    }
+
+    segment = mmap(
+        NULL,
+        timeline->segment_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        descriptor,
+        0
+    );
+
+    if (segment == MAP_FAILED) {
+        fputs("Cannot map timeline segment.\n", stderr);
+        goto error_cleanup_descriptor;
+    }
+
+    close(descriptor);
+
+    /* The segment is zero-filled, only the constants are missing. */
+
+    segment->version = VIBEXEC_TIMELINE_VERSION;
+    segment->capacity = capacity;
+    atomic_store_explicit(
+        &segment->nanoseconds_per_window,
+        session->cache.nanoseconds_per_window,
+        memory_order_relaxed
+    );
+
+    atomic_thread_fence(memory_order_release);
+    segment->magic = VIBEXEC_TIMELINE_MAGIC;
+
+    timeline->segment = segment;
+    return 0;
+
+error_cleanup_descriptor:
+    close(descriptor);
+    shm_unlink(name);
+error_return:
+    return -1;
+}
+
+void vibexec_timeline_publish(
+    struct vibexec_timeline *timeline,
+    const struct vibexec_vibeomatic_session *session,
+    const struct timespec *start,
+    const struct timespec *now
+) {
+    struct vibexec_timeline_segment *segment;
+    struct timespec elapsed;
+    unsigned long current, available, first, limit, window;
+    uint64_t old_limit;
+    uint32_t sequence;
+
+    segment = timeline->segment;
+
+    /* Determine the range of windows that fits into the ring. */
+
+    _compute_difference(&elapsed, now, start);
+
+    current = (unsigned long) (
+        (elapsed.tv_sec * 1000000000.0 + elapsed.tv_nsec)
+        / session->cache.nanoseconds_per_window
+    );
+
+    available =
+        session->cache.score_buffer_first_window
+        + session->cache.score_buffer_limit;
+
+    limit = available < current + segment->capacity
+        ? available
+        : current + segment->capacity;
+
+    /* Only this process writes, relaxed loads are sufficient. */
+
+    old_limit = atomic_load_explicit(
+        &segment->window_limit,
+        memory_order_relaxed
+    );
+
+    if (
+        limit <= old_limit
+        && atomic_load_explicit(&segment->start, memory_order_relaxed)
+    ) {
+        return;
+    }
+
+    first = atomic_load_explicit(&segment->first_window, memory_order_relaxed);
+    window = old_limit;
+
+    /* Scores that were dropped unpublished leave a gap. */
+
+    if (window < session->cache.score_buffer_first_window) {
+        window = session->cache.score_buffer_first_window;
+        first = window;
+    }
+
+    if (limit > segment->capacity && first < limit - segment->capacity) {
+        first = limit - segment->capacity;
+    }
+
+    if (window < first) {
+        window = first;
+    }
+
+    /* Write section. */
+
+    sequence = atomic_load_explicit(&segment->sequence, memory_order_relaxed);
+    atomic_store_explicit(
+        &segment->sequence,
+        sequence + 1,
+        memory_order_relaxed
+    );
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(
+        &segment->start,
+        (uint64_t) start->tv_sec * 1000000000 + (uint64_t) start->tv_nsec,
+        memory_order_relaxed
+    );
+
+    for (; window < limit; window++) {
+        atomic_store_explicit(
+            &segment->scores[window & (segment->capacity - 1)],
+            session->cache.score_buffer[
+                window - session->cache.score_buffer_first_window
+            ],
+            memory_order_relaxed
+        );
+    }
+
+    atomic_store_explicit(&segment->first_window, first, memory_order_relaxed);
+    atomic_store_explicit(&segment->window_limit, limit, memory_order_relaxed);
+
+    atomic_store_explicit(
+        &segment->sequence,
+        sequence + 2,
+        memory_order_release
+    );
+}
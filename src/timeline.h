@@ -0,0 +1,154 @@
+#ifndef _VIBEXEC_TIMELINE_H_
+#define _VIBEXEC_TIMELINE_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Score timeline that is published into a named shared-memory segment, which
+ * allows programs to throttle themselves by the vibe without being stopped.
+ *
+ * The segment holds a ring of upcoming scores, indexed by the window since the
+ * start of the vibe on CLOCK_MONOTONIC. Updates are guarded by a sequence
+ * lock: the sequence is odd while the writer modifies the segment, readers
+ * retry if it was odd or changed while they read. This header is
+ * self-contained, such that consumers can use vibexec_timeline_read on their
+ * own mapping of the segment.
+ *
+ * Each run creates a new object under the name and never resizes it, hence
+ * mappings stay valid. Consumers map the name again, once their timeline
+ * stops advancing.
+ */
+
+#define VIBEXEC_TIMELINE_MAGIC 0x54584256U
+#define VIBEXEC_TIMELINE_VERSION 1U
+
+/*
+ * Attempts of a read, before it gives up. The sequence stays odd forever, if
+ * the writer dies while publishing.
+ */
+#define VIBEXEC_TIMELINE_READ_ATTEMPTS 1024
+
+struct vibexec_timeline_segment {
+    /* Constant after creation. */
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+
+    _Atomic uint32_t sequence;
+
+    /* Start of the vibe in nanoseconds, zero until the playback starts. */
+
+    _Atomic uint64_t start;
+    _Atomic double nanoseconds_per_window;
+
+    /* Windows with valid scores: [first_window, window_limit) */
+
+    _Atomic uint64_t first_window;
+    _Atomic uint64_t window_limit;
+
+    /* Ring of capacity (power of two) scores, indexed by window. */
+
+    _Atomic double scores[];
+};
+
+struct vibexec_vibeomatic_session;
+
+struct vibexec_timeline {
+    const char *name;
+    struct vibexec_timeline_segment *segment;
+    unsigned long segment_size;
+};
+
+void vibexec_timeline_cleanup(struct vibexec_timeline *timeline);
+
+/* Creates the segment, sized for the window timing of the session. */
+int vibexec_timeline_initialize(
+    struct vibexec_timeline *timeline,
+    const char *name,
+    const struct vibexec_vibeomatic_session *session
+);
+
+/*
+ * Publishes the scores of the session that are not yet published, as far as
+ * the ring permits ahead of now. Both times refer to CLOCK_MONOTONIC.
+ */
+void vibexec_timeline_publish(
+    struct vibexec_timeline *timeline,
+    const struct vibexec_vibeomatic_session *session,
+    const struct timespec *start,
+    const struct timespec *now
+);
+
+/* Inline functions. */
+
+/*
+ * Looks up the score at now (CLOCK_MONOTONIC in nanoseconds). Fails if the
+ * timeline does not cover now, or keeps changing during all attempts.
+ */
+static inline int vibexec_timeline_read(
+    const struct vibexec_timeline_segment *segment,
+    uint64_t now,
+    double *score
+) {
+    uint32_t sequence;
+    uint64_t start, window;
+    unsigned int attempt;
+    int found;
+
+    for (attempt = 0; attempt < VIBEXEC_TIMELINE_READ_ATTEMPTS; attempt++) {
+        sequence = atomic_load_explicit(
+            &segment->sequence,
+            memory_order_acquire
+        );
+
+        if (sequence & 1) {
+            continue;
+        }
+
+        start = atomic_load_explicit(&segment->start, memory_order_relaxed);
+        found = 0;
+
+        if (start && now >= start) {
+            window = (uint64_t) (
+                (now - start)
+                / atomic_load_explicit(
+                    &segment->nanoseconds_per_window,
+                    memory_order_relaxed
+                )
+            );
+
+            found =
+                window >= atomic_load_explicit(
+                    &segment->first_window,
+                    memory_order_relaxed
+                )
+                && window < atomic_load_explicit(
+                    &segment->window_limit,
+                    memory_order_relaxed
+                );
+
+            if (found) {
+                *score = atomic_load_explicit(
+                    &segment->scores[window & (segment->capacity - 1)],
+                    memory_order_relaxed
+                );
+            }
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+
+        if (
+            atomic_load_explicit(&segment->sequence, memory_order_relaxed)
+                == sequence
+        ) {
+            return found ? 0 : -1;
+        }
+    }
+
+    return -1;
+}
+
+#endif
@@ -0,0 +1,220 @@
+#include <errno.h>
+#include <stdio.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "governor.h"
+#include "scheduler.h"
+#include "tracee.h"
+
+void vibexec_tracee_collect_stops(
+    void (*handle_stop)(void *context, pid_t pid, int status),
+    void *context
+) {
+    int status;
+    pid_t pid;
+
+    while ((pid = waitpid(-1, &status, WNOHANG | __WALL)) > 0) {
+        handle_stop(context, pid, status);
+    }
+}
+
+int vibexec_tracee_detach(struct vibexec_tracee *tracee) {
+    long status;
+
+    status = ptrace(
+        PTRACE_DETACH,
+        tracee->pid,
+        NULL,
+        (void *) (long) tracee->pending_signal
+    );
+
+    if (status == -1) {
+        fputs("Cannot detach tracee.\n", stderr);
+        return -1;
+    }
+
+    tracee->pending_signal = 0;
+    return 0;
+}
+
+int vibexec_tracee_handle_status(struct vibexec_tracee *tracee, int status) {
+    if (WIFEXITED(status) || WIFSIGNALED(status)) {
+        return 1;
+    }
+
+    /*
+     * System call stops are reported as SIGTRAP | 0x80, everything else is a
+     * signal that needs to be delivered to the tracee.
+     */
+
+    tracee->pending_signal = 0;
+
+    if (WIFSTOPPED(status) && WSTOPSIG(status) != (SIGTRAP | 0x80)) {
+        tracee->pending_signal = WSTOPSIG(status);
+
+        /* Neither ptrace events nor group stops carry a signal. */
+
+        if (status >> 16) {
+            tracee->pending_signal = 0;
+        }
+    }
+
+    return 0;
+}
+
+void vibexec_tracee_pause(
+    struct vibexec_tracee *tracee,
+    struct vibexec_scheduler *scheduler,
+    struct timespec *pause
+) {
+    struct timespec stop_time;
+
+    /* The scheduler may analyze the vibe, which is not the tracee's time. */
+
+    clock_gettime(CLOCK_MONOTONIC, &stop_time);
+    vibexec_scheduler_next_pause(scheduler, pause);
+    vibexec_governor_limit(&tracee->governor, &stop_time, pause);
+}
+
+int vibexec_tracee_resume(struct vibexec_tracee *tracee) {
+    struct timespec resume_time;
+    long status;
+
+    status = ptrace(
+        PTRACE_SYSCALL,
+        tracee->pid,
+        NULL,
+        (void *) (long) tracee->pending_signal
+    );
+
+    /* Threads vanish without notice, if another one exits the process. */
+
+    if (status == -1) {
+        if (errno != ESRCH) {
+            fputs("Cannot resume tracee.\n", stderr);
+        }
+
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &resume_time);
+    vibexec_governor_resume(&tracee->governor, &resume_time);
+
+    tracee->pending_signal = 0;
+    return 0;
+}
+
+int vibexec_tracee_seize(struct vibexec_tracee *tracee, pid_t pid) {
+    long status;
+
+    tracee->pid = pid;
+    tracee->pending_signal = 0;
+
+    /*
+     * Follow new threads, they are attached automatically. Exec events
+     * replace the SIGTRAP after execve, which must not reach the program.
+     */
+
+    status = ptrace(
+        PTRACE_SEIZE,
+        pid,
+        NULL,
+        (void *) (long) (
+            PTRACE_O_TRACESYSGOOD
+            | PTRACE_O_TRACECLONE
+            | PTRACE_O_TRACEEXEC
+        )
+    );
+
+    if (status == -1) {
+        return -1;
+    }
+
+    /* Stop it, such that system call tracing can be enabled. */
+
+    if (ptrace(PTRACE_INTERRUPT, pid, NULL, NULL) == -1) {
+        ptrace(PTRACE_DETACH, pid, NULL, NULL);
+        return -1;
+    }
+
+    return 0;
+}
+
+int vibexec_tracee_spawn(
+    struct vibexec_tracee *tracee,
+    char *const program[]
+) {
+    if ((tracee->pid = fork()) == -1) {
+        fputs("Fork failed.\n", stderr);
+        return -1;
+    }
+
+    if (tracee->pid == 0) {
+        sigset_t signals;
+        int status;
+
+        /* Do not leak the signal mask of the tracer into the program. */
+
+        sigemptyset(&signals);
+        sigprocmask(SIG_SETMASK, &signals, NULL);
+
+        /* Ask the parent to trace me. */
+
+        status = ptrace(PTRACE_TRACEME, 0, 0, 0);
+
+        if (status == -1) {
+            fputs("Trace request failed.\n", stderr);
+            _exit(1);
+        }
+
+        status = raise(SIGSTOP);
+
+        if (status) {
+            fputs("Waiting for parent failed.\n", stderr);
+            _exit(1);
+        }
+
+        /* Launch the actual application. */
+
+        status = execvp(program[0], program);
+
+        /*
+         * The execvp call does not return, if successful. Branching only for
+         * esthetic reasons.
+         */
+
+        if (status) {
+            fprintf(stderr, "Failed launching '%s'.\n", program[0]);
+            _exit(1);
+        }
+
+        _exit(0);
+    }
+
+    /* Wait for child. */
+
+    if (waitpid(tracee->pid, NULL, 0) == -1) {
+        fputs("Waiting for tracee failed.\n", stderr);
+        return -1;
+    }
+
+    /*
+     * Distinguish system call stops from signals. Exec events replace the
+     * SIGTRAP after execve, such that any SIGTRAP is a genuine signal.
+     */
+
+    ptrace(
+        PTRACE_SETOPTIONS,
+        tracee->pid,
+        NULL,
+        (void *) (long) (PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACEEXEC)
+    );
+    tracee->pending_signal = 0;
+
+    return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef _VIBEXEC_TRACEE_H_
+#define _VIBEXEC_TRACEE_H_
+
+#include <time.h>
+#include <sys/types.h>
+#include "governor.h"
+#include "scheduler.h"
+
+struct vibexec_tracee {
+    pid_t pid;
+
+    /* Signal that is delivered when the tracee is resumed next time. */
+
+    int pending_signal;
+
+    /* Bounds the slowdown, must be initialized by the caller. */
+
+    struct vibexec_governor governor;
+};
+
+/*
+ * Passes every pending stop of any traced child or thread to the handler,
+ * without blocking. Child notifications coalesce, hence a single one may stand
+ * for several stops.
+ */
+void vibexec_tracee_collect_stops(
+    void (*handle_stop)(void *context, pid_t pid, int status),
+    void *context
+);
+
+/* Releases the stopped tracee, delivering its pending signal. */
+int vibexec_tracee_detach(struct vibexec_tracee *tracee);
+
+/*
+ * Records the status of a stopped tracee, as reported by waitpid. Returns
+ * non-zero, if the tracee terminated.
+ */
+int vibexec_tracee_handle_status(struct vibexec_tracee *tracee, int status);
+
+/* Determines the pause of the current stop within the slowdown budget. */
+void vibexec_tracee_pause(
+    struct vibexec_tracee *tracee,
+    struct vibexec_scheduler *scheduler,
+    struct timespec *pause
+);
+
+/* Resumes the tracee until its next system call entry or exit. */
+int vibexec_tracee_resume(struct vibexec_tracee *tracee);
+
+/*
+ * Attaches to the thread pid of a running process, which reports an event stop
+ * as soon as it is interrupted. Its new threads are traced as well.
+ */
+int vibexec_tracee_seize(struct vibexec_tracee *tracee, pid_t pid);
+
+/*
+ * Launches the program as traced child and waits until it is stopped before
+ * its execution.
+ */
+int vibexec_tracee_spawn(
+    struct vibexec_tracee *tracee,
+    char *const program[]
+);
+
+#endif
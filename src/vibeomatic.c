@@ -3,9 +3,20 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "resampler.h"
+#include "schedulable.h"
 #include "vibeomatic.h"
 
 static inline int _is_ge_than(const struct timespec *left, double right);
+static int _reserve(
+    struct vibexec_vibeomatic_session *session,
+    unsigned long frame_count
+);
+
+static int _push_score(
+    struct vibexec_vibeomatic_session *session,
+    double score
+);
 static inline double _score(
     kiss_fft_cpx *last_window,
     kiss_fft_cpx *current_window,
@@ -17,63 +28,102 @@ void vibexec_vibeomatic_analyze(
     void *buffer,
     unsigned long buffer_size
 ) {
-    kiss_fft_cpx *wnd_cur_in, *wnd_cur_out, *wnd_last;
-    unsigned long buffer_offset;
+    unsigned long frame, frame_count, sample, sample_count;
+    const float *samples;
+
+    frame_count = buffer_size / session->cache.frame_size_in_bytes;
+
+    if (_reserve(session, frame_count)) {
+        return;
+    }
+
+    /* Decode the buffer and normalize to mono channel. */
+
+    for (frame = 0; frame < frame_count; frame++) {
+        float amplitude = 0.0F;
+        int channel;
+
+        for (
+            channel = 0;
+            channel < session->parameters->channels;
+            channel++
+        ) {
+            switch (session->parameters->sample_format) {
+                case SIGNED_8BIT:
+                    amplitude += ((char *) buffer)[
+                        frame * session->parameters->channels +
+                        channel
+                    ] / 128.0F;
+                    break;
+
+                case SIGNED_16BIT:
+                    amplitude += ((short *) buffer)[
+                        frame * session->parameters->channels +
+                        channel
+                    ] / 32767.0F;
+                    break;
+
+                default:
+                    fputs("Unknown sample format.\n", stderr);
+                    return;
+            }
+        }
 
-    /* Aliasing. */
+        session->cache.decoded[frame] = amplitude;
+    }
+
+    /* Reduce the rate, if requested. */
+
+    samples = session->cache.decoded;
+    sample_count = frame_count;
+
+    if (session->decimation > 1) {
+        long decimated_count;
 
-    wnd_last = session->cache.last_window_out;
-    wnd_cur_in = session->cache.current_window_in;
-    wnd_cur_out = session->cache.current_window_out;
+        decimated_count = vibexec_resampler_process(
+            &session->cache.resampler,
+            session->cache.decoded,
+            frame_count,
+            session->cache.decimated
+        );
+
+        if (decimated_count < 0) {
+            fputs("Cannot decimate vibe.\n", stderr);
+            return;
+        }
+
+        samples = session->cache.decimated;
+        sample_count = (unsigned long) decimated_count;
+    }
 
     /* Do the FFT for each complete window and score. */
 
-    for (
-        buffer_offset = 0;
-        buffer_size - buffer_offset >= session->cache.window_size_in_bytes;
-        buffer_offset += session->cache.window_size_in_bytes
-    ) {
-        int sample;
+    for (sample = 0; sample < sample_count; sample++) {
+        kiss_fft_cpx *wnd_cur_in, *wnd_cur_out, *wnd_last;
         double score;
 
-        /* Decode the window and normalize to mono channel. */
-
-        for (sample = 0; sample < session->sample_window_size; sample++) {
-            float amplitude = 0.0F;
-            int channel;
-
-            for (
-                channel = 0;
-                channel < session->parameters->channels;
-                channel++
-            ) {
-                switch (session->parameters->sample_format) {
-                    case SIGNED_8BIT:
-                        amplitude += ((char *) buffer)[
-                            buffer_offset +
-                            sample * session->parameters->channels +
-                            channel
-                        ] / 128.0F;
-                        break;
-
-                    case SIGNED_16BIT:
-                        amplitude += ((short *) buffer)[
-                            (buffer_offset >> 1) +
-                            sample * session->parameters->channels +
-                            channel
-                        ] / 32767.0F;
-                        break;
-
-                    default:
-                        fputs("Unknown sample format.\n", stderr);
-                        return;
-                }
-            }
+        /* Aliasing. */
+
+        wnd_last = session->cache.last_window_out;
+        wnd_cur_in = session->cache.current_window_in;
+        wnd_cur_out = session->cache.current_window_out;
+
+        /*
+         * Windows may span several buffers. The amplitude is scaled by the
+         * decimation, such that the spectrum matches the one of a full-rate
+         * window of the same duration.
+         */
 
-            wnd_cur_in[sample].i = 0.0F;
-            wnd_cur_in[sample].r = amplitude;
+        wnd_cur_in[session->cache.window_fill].i = 0.0F;
+        wnd_cur_in[session->cache.window_fill].r =
+            samples[sample] * session->cache.amplitude_scale;
+
+        if (++session->cache.window_fill < session->sample_window_size) {
+            continue;
         }
 
+        session->cache.window_fill = 0;
+
         /* Perform the FFT. */
 
         kiss_fft(session->cache.fft_config, wnd_cur_in, wnd_cur_out);
@@ -85,51 +135,10 @@ void vibexec_vibeomatic_analyze(
 
         score = _score(wnd_last, wnd_cur_out, session->sample_window_size);
 
-        if (
-            session->cache.score_buffer_limit == session->cache.score_buffer_capacity
-        ) {
-            if (session->cache.score_buffer_offset_index) {
-                /* If possible, shrink. */
-
-                memmove(
-                    session->cache.score_buffer,
-                    session->cache.score_buffer +
-                        session->cache.score_buffer_offset_index,
-                    sizeof(double) *
-                        (session->cache.score_buffer_limit -
-                            session->cache.score_buffer_offset_index)
-                );
-
-                session->cache.score_buffer_limit -=
-                    session->cache.score_buffer_offset_index;
-
-                session->cache.score_buffer_offset_index = 0;
-            } else {
-                unsigned long new_capacity;
-                double *new_buffer;
-
-                /* Otherwise, increase size. */
-
-                new_capacity = session->cache.score_buffer_capacity << 1;
-                new_buffer = realloc(
-                    session->cache.score_buffer,
-                    sizeof(double) * new_capacity
-                );
-
-                if (!new_buffer) {
-                    fputs("Cannot increase score buffer size.\n", stderr);
-                    return;
-                }
-
-                session->cache.score_buffer = new_buffer;
-                session->cache.score_buffer_capacity = new_capacity;
-            }
+        if (_push_score(session, score)) {
+            return;
         }
 
-        session->cache.score_buffer[
-            session->cache.score_buffer_limit++
-        ] = score;
-
         /* Finalization. */
 
         session->cache.last_window_out = wnd_cur_out;
@@ -137,12 +146,34 @@ void vibexec_vibeomatic_analyze(
     }
 }
 
+int vibexec_vibeomatic_append_scores(
+    struct vibexec_vibeomatic_session *session,
+    const double *scores,
+    unsigned long score_count
+) {
+    unsigned long i;
+
+    for (i = 0; i < score_count; i++) {
+        if (_push_score(session, scores[i])) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 void vibexec_vibeomatic_cleanup(struct vibexec_vibeomatic_session *session) {
     free(session->cache.last_window_out);
     free(session->cache.current_window_out);
     free(session->cache.current_window_in);
     free(session->cache.fft_config);
     free(session->cache.score_buffer);
+    free(session->cache.decoded);
+    free(session->cache.decimated);
+
+    if (session->decimation > 1) {
+        vibexec_resampler_cleanup(&session->cache.resampler);
+    }
 }
 
 double vibexec_vibeomatic_drop_and_score(
@@ -207,20 +238,26 @@ double vibexec_vibeomatic_drop_and_score(
 int vibexec_vibeomatic_initialize(
     struct vibexec_vibeomatic_session *session,
     const struct vibexec_schedulable_parameters *parameters,
-    unsigned long sample_window_size
+    unsigned long sample_window_size,
+    unsigned long decimation
 ) {
+    if (!sample_window_size) {
+        fputs("Empty analysis window.\n", stderr);
+        goto error_return;
+    }
+
     session->parameters = parameters;
     session->sample_window_size = sample_window_size;
+    session->decimation = decimation ? decimation : 1;
 
     /* Cache preparation. */
 
     session->cache.nanoseconds_per_window =
         1000000000.0
-        * ((double) sample_window_size)
+        * ((double) (sample_window_size * session->decimation))
         / ((double) session->parameters->sample_frequency);
 
-    session->cache.window_size_in_bytes =
-        session->sample_window_size * session->parameters->channels;
+    session->cache.frame_size_in_bytes = session->parameters->channels;
 
     switch (session->parameters->sample_format) {
         case SIGNED_8BIT:
@@ -228,7 +265,7 @@ int vibexec_vibeomatic_initialize(
             break;
 
         case SIGNED_16BIT:
-            session->cache.window_size_in_bytes <<= 1;
+            session->cache.frame_size_in_bytes <<= 1;
             break;
 
         default:
@@ -236,6 +273,17 @@ int vibexec_vibeomatic_initialize(
             goto error_return;
     }
 
+    session->cache.window_size_in_bytes =
+        session->sample_window_size
+        * session->decimation
+        * session->cache.frame_size_in_bytes;
+
+    session->cache.amplitude_scale = (float) session->decimation;
+    session->cache.window_fill = 0;
+    session->cache.decoded = NULL;
+    session->cache.decimated = NULL;
+    session->cache.decoded_capacity = 0;
+
     session->cache.last_window_out = calloc(
         session->sample_window_size,
         sizeof(kiss_fft_cpx)
@@ -274,13 +322,33 @@ int vibexec_vibeomatic_initialize(
         goto error_cleanup_current_window_out;
     }
 
+    /* Cache preparation: anti-aliased decimation */
+
+    if (session->decimation > 1) {
+        int failure;
+
+        failure = vibexec_resampler_initialize(
+            &session->cache.resampler,
+            1,
+            session->parameters->sample_frequency,
+            session->parameters->sample_frequency / session->decimation
+        );
+
+        if (failure) {
+            fputs("Cannot initialize decimation.\n", stderr);
+            goto error_cleanup_fft_config;
+        }
+    }
+
     /* Cache preparation: score buffer */
 
     memset(&session->cache.score_buffer_offset, 0, sizeof(struct timespec));
     session->cache.score_buffer_limit = 0;
     session->cache.score_buffer_offset_index = 0;
+    session->cache.score_buffer_first_window = 0;
     session->cache.score_buffer_capacity =
-        (session->parameters->sample_frequency / session->sample_window_size)
+        (session->parameters->sample_frequency
+            / (session->sample_window_size * session->decimation))
         + 1;
 
     session->cache.score_buffer = malloc(
@@ -289,7 +357,7 @@ int vibexec_vibeomatic_initialize(
 
     if (!session->cache.score_buffer) {
         fputs("Cannot allocate memory.\n", stderr);
-        goto error_cleanup_fft_config;
+        goto error_cleanup_resampler;
     }
 
     /* Cache preparation: score buffer: initialize first (fixed) score */
@@ -299,6 +367,10 @@ int vibexec_vibeomatic_initialize(
 
     return 0;
 
+error_cleanup_resampler:
+    if (session->decimation > 1) {
+        vibexec_resampler_cleanup(&session->cache.resampler);
+    }
 error_cleanup_fft_config:
     free(session->cache.fft_config);
 error_cleanup_current_window_out:
@@ -311,10 +383,157 @@ error_return:
     return -1;
 }
 
+double vibexec_vibeomatic_quiet_span(
+    const struct vibexec_vibeomatic_session *session,
+    double threshold,
+    const struct timespec *offset,
+    double horizon
+) {
+    unsigned long window, buffer_limit;
+    double offset_nanoseconds, span;
+
+    /* Scores before the buffer are gone, hence never quiet. */
+
+    offset_nanoseconds = offset->tv_sec * 1000000000.0 + offset->tv_nsec;
+    window = (unsigned long)
+        (offset_nanoseconds / session->cache.nanoseconds_per_window);
+
+    if (window < session->cache.score_buffer_first_window) {
+        return 0.0;
+    }
+
+    /* Scan ahead until a loud window, the horizon or the unknown. */
+
+    buffer_limit =
+        session->cache.score_buffer_first_window
+        + session->cache.score_buffer_limit;
+
+    for (span = 0.0; window < buffer_limit; window++) {
+        span =
+            window * session->cache.nanoseconds_per_window
+            - offset_nanoseconds;
+
+        if (
+            span >= horizon
+            || session->cache.score_buffer[
+                window - session->cache.score_buffer_first_window
+            ] < threshold
+        ) {
+            break;
+        }
+    }
+
+    if (window == buffer_limit) {
+        span =
+            window * session->cache.nanoseconds_per_window
+            - offset_nanoseconds;
+    }
+
+    if (span < 0.0) {
+        span = 0.0;
+    }
+
+    return span < horizon ? span : horizon;
+}
+
 static inline int _is_ge_than(const struct timespec *left, double right) {
     return (left->tv_sec > 0) || (left->tv_nsec > right);
 }
 
+static int _reserve(
+    struct vibexec_vibeomatic_session *session,
+    unsigned long frame_count
+) {
+    float *decoded, *decimated;
+
+    if (frame_count <= session->cache.decoded_capacity) {
+        return 0;
+    }
+
+    decoded = realloc(session->cache.decoded, sizeof(float) * frame_count);
+
+    if (!decoded) {
+        fputs("Cannot allocate memory.\n", stderr);
+        return -1;
+    }
+
+    session->cache.decoded = decoded;
+
+    if (session->decimation > 1) {
+        decimated = realloc(
+            session->cache.decimated,
+            sizeof(float) * vibexec_resampler_output_frames(
+                &session->cache.resampler,
+                frame_count
+            )
+        );
+
+        if (!decimated) {
+            fputs("Cannot allocate memory.\n", stderr);
+            return -1;
+        }
+
+        session->cache.decimated = decimated;
+    }
+
+    session->cache.decoded_capacity = frame_count;
+    return 0;
+}
+
+static int _push_score(
+    struct vibexec_vibeomatic_session *session,
+    double score
+) {
+    /* Restructure the memory first, if the score buffer is exhausted. */
+
+    if (
+        session->cache.score_buffer_limit == session->cache.score_buffer_capacity
+    ) {
+        if (session->cache.score_buffer_offset_index) {
+            /* If possible, shrink. */
+
+            memmove(
+                session->cache.score_buffer,
+                session->cache.score_buffer +
+                    session->cache.score_buffer_offset_index,
+                sizeof(double) *
+                    (session->cache.score_buffer_limit -
+                        session->cache.score_buffer_offset_index)
+            );
+
+            session->cache.score_buffer_limit -=
+                session->cache.score_buffer_offset_index;
+
+            session->cache.score_buffer_first_window +=
+                session->cache.score_buffer_offset_index;
+
+            session->cache.score_buffer_offset_index = 0;
+        } else {
+            unsigned long new_capacity;
+            double *new_buffer;
+
+            /* Otherwise, increase size. */
+
+            new_capacity = session->cache.score_buffer_capacity << 1;
+            new_buffer = realloc(
+                session->cache.score_buffer,
+                sizeof(double) * new_capacity
+            );
+
+            if (!new_buffer) {
+                fputs("Cannot increase score buffer size.\n", stderr);
+                return -1;
+            }
+
+            session->cache.score_buffer = new_buffer;
+            session->cache.score_buffer_capacity = new_capacity;
+        }
+    }
+
+    session->cache.score_buffer[session->cache.score_buffer_limit++] = score;
+    return 0;
+}
+
 static inline double _score(
     kiss_fft_cpx *last_window,
     kiss_fft_cpx *current_window,
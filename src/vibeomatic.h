@@ -3,15 +3,40 @@
 
 #include <kissfft/kiss_fft.h>
 #include <time.h>
-#include "scheduler.h"
+#include "resampler.h"
+
+/*
+ * Smallest window, at which the score can still reach one: it saturates at
+ * 200 large coefficients, counting two criteria per coefficient.
+ */
+#define VIBEXEC_VIBEOMATIC_MINIMUM_WINDOW_SIZE 100
+
+struct vibexec_schedulable_parameters;
 
 struct vibexec_vibeomatic_session {
     const struct vibexec_schedulable_parameters *parameters;
     unsigned long sample_window_size;
 
+    /*
+     * Factor by which the vibe is decimated before the analysis, the window
+     * size refers to the decimated rate.
+     */
+
+    unsigned long decimation;
+
     struct {
         double nanoseconds_per_window;
         unsigned long window_size_in_bytes;
+        unsigned long frame_size_in_bytes;
+
+        /* Decoding and decimation */
+
+        float *decoded;
+        float *decimated;
+        unsigned long decoded_capacity;
+        struct vibexec_resampler resampler;
+        float amplitude_scale;
+        unsigned long window_fill;
 
         kiss_fft_cpx *last_window_out;
         kiss_fft_cpx *current_window_in;
@@ -26,6 +51,10 @@ struct vibexec_vibeomatic_session {
         unsigned long score_buffer_limit;
         struct timespec score_buffer_offset;
         unsigned long score_buffer_offset_index;
+
+        /* Window of the first score in the buffer. */
+
+        unsigned long score_buffer_first_window;
     } cache;
 };
 
@@ -35,6 +64,12 @@ void vibexec_vibeomatic_analyze(
     unsigned long buffer_size
 );
 
+int vibexec_vibeomatic_append_scores(
+    struct vibexec_vibeomatic_session *session,
+    const double *scores,
+    unsigned long score_count
+);
+
 void vibexec_vibeomatic_cleanup(struct vibexec_vibeomatic_session *session);
 double vibexec_vibeomatic_drop_and_score(
     struct vibexec_vibeomatic_session *session,
@@ -44,7 +79,19 @@ double vibexec_vibeomatic_drop_and_score(
 int vibexec_vibeomatic_initialize(
     struct vibexec_vibeomatic_session *session,
     const struct vibexec_schedulable_parameters *parameters,
-    unsigned long sample_window_size
+    unsigned long sample_window_size,
+    unsigned long decimation
+);
+
+/*
+ * Determines for how many nanoseconds after the offset all known scores stay
+ * at or above the threshold, but at most the horizon.
+ */
+double vibexec_vibeomatic_quiet_span(
+    const struct vibexec_vibeomatic_session *session,
+    double threshold,
+    const struct timespec *offset,
+    double horizon
 );
 
 /* Inline functions. */